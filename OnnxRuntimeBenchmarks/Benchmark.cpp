@@ -0,0 +1,161 @@
+#include "Benchmark.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <stdexcept>
+
+namespace Bench
+{
+	const void* volatile Sink = nullptr;
+}
+
+// every operator new of the benchmarks goes through these counters
+static std::atomic<std::uint64_t> allocatedBytes{ 0 };
+static std::atomic<std::uint64_t> allocations{ 0 };
+
+static void CountAllocation(std::size_t size)
+{
+	allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+	allocations.fetch_add(1, std::memory_order_relaxed);
+}
+
+void* operator new(std::size_t size)
+{
+	CountAllocation(size);
+	if (auto* p = std::malloc(size ? size : 1))
+		return p;
+	throw std::bad_alloc{};
+}
+
+void* operator new[](std::size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete(void* p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+	std::free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept
+{
+	std::free(p);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+	CountAllocation(size);
+	const auto align = static_cast<std::size_t>(alignment);
+#ifdef _MSC_VER
+	auto* p = _aligned_malloc(size ? size : 1, align);
+#else
+	auto* p = std::aligned_alloc(align, (std::max<std::size_t>(size, 1) + align - 1) / align * align);
+#endif
+	if (p)
+		return p;
+	throw std::bad_alloc{};
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment)
+{
+	return operator new(size, alignment);
+}
+
+static void AlignedFree(void* p)
+{
+#ifdef _MSC_VER
+	_aligned_free(p);
+#else
+	std::free(p);
+#endif
+}
+
+void operator delete(void* p, std::align_val_t) noexcept
+{
+	AlignedFree(p);
+}
+
+void operator delete[](void* p, std::align_val_t) noexcept
+{
+	AlignedFree(p);
+}
+
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept
+{
+	AlignedFree(p);
+}
+
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept
+{
+	AlignedFree(p);
+}
+
+Bench::Result Bench::Run(const std::string& name, const std::function<void()>& op, std::chrono::milliseconds minTime)
+{
+	using Clock = std::chrono::steady_clock;
+	op();
+
+	// grow the batch until it lasts about 1/20 of minTime, so that the clock resolution does not matter
+	size_t batch = 1;
+	for (;;)
+	{
+		const auto tic = Clock::now();
+		for (size_t i = 0; i < batch; ++i)
+			op();
+		if (Clock::now() - tic >= minTime / 20)
+			break;
+		batch *= 2;
+	}
+
+	Result result{ name };
+	auto best = Clock::duration::max();
+	const auto bytesBefore = allocatedBytes.load(std::memory_order_relaxed);
+	const auto allocationsBefore = allocations.load(std::memory_order_relaxed);
+	const auto start = Clock::now();
+	while (Clock::now() - start < minTime)
+	{
+		const auto tic = Clock::now();
+		for (size_t i = 0; i < batch; ++i)
+			op();
+		best = std::min(best, Clock::now() - tic);
+		result.Iterations += batch;
+	}
+	result.NanosecondsPerOp = std::chrono::duration<double, std::nano>(best).count() / batch;
+	result.BytesPerOp = static_cast<double>(allocatedBytes.load(std::memory_order_relaxed) - bytesBefore) / result.Iterations;
+	result.AllocationsPerOp = static_cast<double>(allocations.load(std::memory_order_relaxed) - allocationsBefore) / result.Iterations;
+	return result;
+}
+
+void Bench::Print(std::ostream& os, const Result& result, const Result* baseline)
+{
+	os << std::left << std::setw(48) << result.Name << std::right << std::fixed << std::setprecision(1)
+		<< std::setw(12) << result.NanosecondsPerOp << " ns/op" << std::setw(11) << result.BytesPerOp << " B/op"
+		<< std::setprecision(2) << std::setw(8) << result.AllocationsPerOp << " allocs/op";
+	if (baseline && result.NanosecondsPerOp > 0)
+	{
+		os << std::setprecision(2) << std::setw(8) << baseline->NanosecondsPerOp / result.NanosecondsPerOp << "x";
+	}
+	os << "\n";
+}
+
+void Bench::Check(bool passed, const std::string& what)
+{
+	if (!passed)
+	{
+		throw std::runtime_error("check failed: " + what);
+	}
+}
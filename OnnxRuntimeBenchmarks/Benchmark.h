@@ -0,0 +1,41 @@
+#pragma once
+#include <chrono>
+#include <functional>
+#include <iosfwd>
+#include <string>
+
+namespace Bench
+{
+	struct Result
+	{
+		std::string Name;
+		double NanosecondsPerOp = 0;
+		// allocated with new by the whole process during the measured batches: the buffers OpenCV and ORT allocate
+		// with their own allocators do not count
+		double BytesPerOp = 0;
+		double AllocationsPerOp = 0;
+		size_t Iterations = 0;
+	};
+
+	// keeps the compiler from optimizing away the computation of value
+	template<typename T>
+	void DoNotOptimize(const T& value)
+	{
+#if defined(__GNUC__) || defined(__clang__)
+		asm volatile("" : : "r,m"(value) : "memory");
+#else
+		extern const void* volatile Sink;
+		Sink = &value;
+#endif
+	}
+
+	// calls op once to warm up, then in batches until minTime has elapsed: the fastest batch gives ns/op
+	Result Run(const std::string& name, const std::function<void()>& op, std::chrono::milliseconds minTime = std::chrono::milliseconds{ 300 });
+
+	// one line per result: ns/op, B/op and allocations/op, ratio is the speedup relative to baseline (e.g. the current implementation)
+	void Print(std::ostream& os, const Result& result, const Result* baseline = nullptr);
+
+	// the benchmarks also check that the variants they time compute the same thing as the code they replace:
+	// throws std::runtime_error naming what differs, which stops the run with a non-zero exit code
+	void Check(bool passed, const std::string& what);
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+// each group prints its results to std::cout
+namespace Bench
+{
+	void RunSoftmaxBenchmarks();
+	void RunNmsBenchmarks();
+	void RunDetectionBenchmarks();
+	void RunInstrumentationBenchmarks();
+	void RunKernelBenchmarks();
+	void RunSessionBenchmarks();
+}
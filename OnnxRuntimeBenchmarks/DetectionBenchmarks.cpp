@@ -0,0 +1,448 @@
+#include "Benchmarks.h"
+#include "Benchmark.h"
+#include "Box.h"
+#include "MobileNet.h"
+#include "Selection.h"
+#include "Softmax.h"
+#include "SsdPriors.h"
+#include "Nms.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+#include <xtensor/xarray.hpp>
+#include <xtensor/xadapt.hpp>
+
+// the SSD head of MobileNet: 8k priors and 91 classes (0 is the background)
+static const size_t Priors = 8190;
+static const size_t Classes = 91;
+static const float ConfThreshold = 0.3f;
+static const float CenterVariance = 0.1f;
+static const float SizeVariance = 0.2f;
+
+struct DetectorOutputs
+{
+	// [priors, classes] as the session writes them, about 1% of the scores pass the threshold
+	std::vector<float> Scores;
+	// [classes, priors], the same scores transposed
+	std::vector<float> ClassMajor;
+	// [priors, 4], (x center, y center, width, height) offsets
+	std::vector<float> Locations;
+	std::vector<float> Priors;
+};
+
+static DetectorOutputs RandomOutputs(float passing = 0.01f)
+{
+	std::mt19937 generator{ 11 };
+	std::uniform_real_distribution<float> unit{ 0.0f, 1.0f };
+	std::normal_distribution<float> offset{ 0.0f, 1.0f };
+
+	DetectorOutputs outputs;
+	outputs.Scores.resize(Classes * Priors);
+	for (auto& score : outputs.Scores)
+		score = unit(generator) < passing ? ConfThreshold + unit(generator) * (1 - ConfThreshold) : unit(generator) * ConfThreshold;
+	outputs.Locations.resize(Priors * 4);
+	for (auto& location : outputs.Locations)
+		location = offset(generator);
+	outputs.Priors.resize(Priors * 4);
+	for (auto& prior : outputs.Priors)
+		prior = unit(generator);
+	outputs.ClassMajor.resize(Classes * Priors);
+	for (size_t j = 0; j < Priors; ++j)
+		for (size_t cl = 0; cl < Classes; ++cl)
+			outputs.ClassMajor[cl * Priors + j] = outputs.Scores[j * Classes + cl];
+	return outputs;
+}
+
+static void DecodeBox(const float* location, const float* prior, float* box)
+{
+	const auto x = location[0] * CenterVariance * prior[2] + prior[0];
+	const auto y = location[1] * CenterVariance * prior[3] + prior[1];
+	const auto w = std::exp(location[2] * SizeVariance) * prior[2];
+	const auto h = std::exp(location[3] * SizeVariance) * prior[3];
+	box[0] = x - w / 2;
+	box[1] = y - h / 2;
+	box[2] = x + w / 2;
+	box[3] = y + h / 2;
+}
+
+// what MobileNetPostprocess used to do: decode every prior in place (on a copy here), then scan every score
+static void EagerGather(const DetectorOutputs& outputs, std::vector<float>& locations, Utils::MultiClassNms& nms)
+{
+	locations = outputs.Locations;
+	for (size_t j = 0; j < Priors; ++j)
+		DecodeBox(&outputs.Locations[j * 4], &outputs.Priors[j * 4], &locations[j * 4]);
+
+	nms.Clear(Classes);
+	for (size_t cl = 1; cl < Classes; ++cl)
+	{
+		const auto* scores = &outputs.ClassMajor[cl * Priors];
+		auto& candidates = nms.Candidates(cl);
+		for (size_t j = 0; j < Priors; ++j)
+		{
+			if (scores[j] > ConfThreshold)
+				candidates.Add(scores[j], locations[j * 4 + 0], locations[j * 4 + 1], locations[j * 4 + 2], locations[j * 4 + 3]);
+		}
+	}
+}
+
+static void LazyGather(const DetectorOutputs& outputs, std::vector<std::uint32_t>& selected, Utils::MultiClassNms& nms, Utils::SimdLevel level)
+{
+	nms.Clear(Classes);
+	for (size_t cl = 1; cl < Classes; ++cl)
+	{
+		const Utils::span<const float> scores{ &outputs.ClassMajor[cl * Priors], Priors };
+		selected.clear();
+		Utils::SelectAbove(scores, ConfThreshold, selected, level);
+		auto& candidates = nms.Candidates(cl);
+		for (const auto j : selected)
+		{
+			float box[4];
+			DecodeBox(&outputs.Locations[j * 4], &outputs.Priors[j * 4], box);
+			candidates.Add(scores[j], box[0], box[1], box[2], box[3]);
+		}
+	}
+}
+
+static bool SameCandidates(Utils::MultiClassNms& a, Utils::MultiClassNms& b)
+{
+	for (size_t cl = 1; cl < Classes; ++cl)
+	{
+		const auto& x = a.Candidates(cl);
+		const auto& y = b.Candidates(cl);
+		if (x.Score != y.Score || x.X1 != y.X1 || x.Y1 != y.Y1 || x.X2 != y.X2 || x.Y2 != y.Y2)
+			return false;
+	}
+	return true;
+}
+
+static void CompareGather(float passing)
+{
+	std::cout << "candidates of [" << Classes << ", " << Priors << "] scores, " << passing * 100 << "% above the threshold\n";
+	const auto outputs = RandomOutputs(passing);
+
+	std::vector<float> locations;
+	Utils::MultiClassNms eager;
+	const auto baseline = Bench::Run("decode all, then threshold (previous)", [&] {
+		EagerGather(outputs, locations, eager);
+		Bench::DoNotOptimize(eager.Candidates(1).Size());
+	});
+	Bench::Print(std::cout, baseline);
+
+	std::vector<std::uint32_t> selected;
+	Utils::MultiClassNms lazy;
+	for (const auto level : { Utils::SimdLevel::Scalar, Utils::SimdLevel::Avx2, Utils::SimdLevel::Avx512 })
+	{
+		if (level > Utils::BestSimdLevel())
+			break;
+		const auto result = Bench::Run(std::string{ "select, then decode " } + Utils::ToString(level), [&] {
+			LazyGather(outputs, selected, lazy, level);
+			Bench::DoNotOptimize(lazy.Candidates(1).Size());
+		});
+		Bench::Print(std::cout, result, &baseline);
+		Bench::Check(SameCandidates(eager, lazy), std::string{ "select, then decode " } + Utils::ToString(level) + " gathers other candidates than decode all");
+	}
+	std::cout << "\n";
+}
+
+// the reference: every score read where it is, one class after the other
+static void ReferenceGather(const DetectorOutputs& outputs, Utils::MultiClassNms& nms)
+{
+	nms.Clear(Classes);
+	for (size_t cl = 1; cl < Classes; ++cl)
+	{
+		auto& candidates = nms.Candidates(cl);
+		for (size_t j = 0; j < Priors; ++j)
+		{
+			const auto score = outputs.Scores[j * Classes + cl];
+			if (score > ConfThreshold)
+			{
+				float box[4];
+				DecodeBox(&outputs.Locations[j * 4], &outputs.Priors[j * 4], box);
+				candidates.Add(score, box[0], box[1], box[2], box[3]);
+			}
+		}
+	}
+}
+
+static void GatherClassMajor(const float* classMajor, const DetectorOutputs& outputs, std::vector<std::uint32_t>& selected, Utils::MultiClassNms& nms)
+{
+	nms.Clear(Classes);
+	for (size_t cl = 1; cl < Classes; ++cl)
+	{
+		const Utils::span<const float> scores{ classMajor + cl * Priors, Priors };
+		selected.clear();
+		Utils::SelectAbove(scores, ConfThreshold, selected);
+		auto& candidates = nms.Candidates(cl);
+		for (const auto j : selected)
+		{
+			float box[4];
+			DecodeBox(&outputs.Locations[j * 4], &outputs.Priors[j * 4], box);
+			candidates.Add(scores[j], box[0], box[1], box[2], box[3]);
+		}
+	}
+}
+
+// what Postprocess used to do: transpose the scores in place with xtensor (through a temporary), then gather by class
+static void XtensorTransposeGather(const DetectorOutputs& outputs, std::vector<float>& scores, std::vector<std::uint32_t>& selected, Utils::MultiClassNms& nms)
+{
+	scores = outputs.Scores;
+	const std::vector<std::size_t> shape{ 1, Priors, Classes };
+	auto adapted = xt::adapt(scores.data(), scores.size(), xt::no_ownership(), shape);
+	adapted = xt::transpose(adapted, { 0, 2, 1 });
+	GatherClassMajor(scores.data(), outputs, selected, nms);
+}
+
+// a tiled transpose into a reusable class-major buffer, then gather by class
+static void BlockedTransposeGather(const DetectorOutputs& outputs, std::vector<float>& classMajor, std::vector<std::uint32_t>& selected, Utils::MultiClassNms& nms)
+{
+	const size_t Tile = 16;
+	classMajor.resize(Classes * Priors);
+	for (size_t j0 = 0; j0 < Priors; j0 += Tile)
+	{
+		for (size_t cl0 = 0; cl0 < Classes; cl0 += Tile)
+		{
+			for (auto j = j0; j < std::min(j0 + Tile, Priors); ++j)
+				for (auto cl = cl0; cl < std::min(cl0 + Tile, Classes); ++cl)
+					classMajor[cl * Priors + j] = outputs.Scores[j * Classes + cl];
+		}
+	}
+	GatherClassMajor(classMajor.data(), outputs, selected, nms);
+}
+
+// one scan of the whole candidate-major tensor: a survivor at k is prior k / classes of class k % classes
+static void CandidateMajorGather(const DetectorOutputs& outputs, std::vector<std::uint32_t>& selected, Utils::MultiClassNms& nms)
+{
+	nms.Clear(Classes);
+	selected.clear();
+	Utils::SelectAbove(outputs.Scores, ConfThreshold, selected);
+	for (const auto k : selected)
+	{
+		const auto j = k / Classes;
+		const auto cl = k % Classes;
+		if (cl == 0)
+			continue;
+		float box[4];
+		DecodeBox(&outputs.Locations[j * 4], &outputs.Priors[j * 4], box);
+		nms.Candidates(cl).Add(outputs.Scores[k], box[0], box[1], box[2], box[3]);
+	}
+}
+
+static void CompareLayouts()
+{
+	std::cout << "candidates of [" << Priors << ", " << Classes << "] candidate-major scores\n";
+	const auto outputs = RandomOutputs();
+
+	Utils::MultiClassNms reference;
+	ReferenceGather(outputs, reference);
+
+	std::vector<float> buffer;
+	std::vector<std::uint32_t> selected;
+	Utils::MultiClassNms nms;
+	const auto check = [&](const char* name) {
+		Bench::Check(SameCandidates(reference, nms), std::string{ name } + " gathers other candidates than the reference");
+	};
+
+	const auto baseline = Bench::Run("xtensor transpose, by class (previous)", [&] {
+		XtensorTransposeGather(outputs, buffer, selected, nms);
+		Bench::DoNotOptimize(nms.Candidates(1).Size());
+	});
+	Bench::Print(std::cout, baseline);
+	check("xtensor transpose, by class (previous)");
+
+	const auto blocked = Bench::Run("blocked transpose, by class", [&] {
+		BlockedTransposeGather(outputs, buffer, selected, nms);
+		Bench::DoNotOptimize(nms.Candidates(1).Size());
+	});
+	Bench::Print(std::cout, blocked, &baseline);
+	check("blocked transpose, by class");
+
+	const auto direct = Bench::Run("candidate-major scan", [&] {
+		CandidateMajorGather(outputs, selected, nms);
+		Bench::DoNotOptimize(nms.Candidates(1).Size());
+	});
+	Bench::Print(std::cout, direct, &baseline);
+	check("candidate-major scan");
+	std::cout << "\n";
+}
+
+// [priors, classes] logits: the background wins most priors, a few priors have a clear winner among the objects
+static std::vector<float> RandomLogits()
+{
+	std::mt19937 generator{ 5 };
+	std::normal_distribution<float> logit{ 0.0f, 1.0f };
+	std::uniform_real_distribution<float> unit{ 0.0f, 1.0f };
+	std::uniform_int_distribution<size_t> object{ 1, Classes - 1 };
+
+	std::vector<float> logits(Priors * Classes);
+	for (size_t j = 0; j < Priors; ++j)
+	{
+		auto* row = &logits[j * Classes];
+		for (size_t cl = 0; cl < Classes; ++cl)
+			row[cl] = logit(generator);
+		row[unit(generator) < 0.02f ? object(generator) : 0] += 8.0f;
+	}
+	return logits;
+}
+
+static void CompareSoftmaxThreshold(Utils::SoftmaxMode mode)
+{
+	std::cout << "softmax and threshold of [" << Priors << ", " << Classes << "] logits (" << (mode == Utils::SoftmaxMode::Fast ? "fast" : "exact") << ")\n";
+	const auto logits = RandomLogits();
+
+	// the previous Postprocess: softmax in place on a copy (the outputs must survive), then a second pass for the threshold
+	std::vector<float> scores;
+	std::vector<std::uint32_t> selected;
+	std::vector<Utils::RowProbability> expected;
+	const auto twoPasses = [&](Utils::SimdLevel level) {
+		scores = logits;
+		Utils::SoftmaxRows(scores, Classes, mode, level);
+		selected.clear();
+		Utils::SelectAbove(scores, ConfThreshold, selected, level);
+		expected.clear();
+		for (const auto k : selected)
+		{
+			if (k % Classes != 0)
+				expected.push_back({ static_cast<std::uint32_t>(k / Classes), static_cast<std::uint32_t>(k % Classes), scores[k] });
+		}
+	};
+	const auto baseline = Bench::Run("SoftmaxRows, then threshold (previous)", [&] {
+		twoPasses(Utils::BestSimdLevel());
+		Bench::DoNotOptimize(expected.size());
+	});
+	Bench::Print(std::cout, baseline);
+
+	std::vector<Utils::RowProbability> fused;
+	for (const auto level : { Utils::SimdLevel::Scalar, Utils::SimdLevel::Avx2, Utils::SimdLevel::Avx512 })
+	{
+		if (level > Utils::BestSimdLevel())
+			break;
+		const auto result = Bench::Run(std::string{ "SoftmaxRowsAbove " } + Utils::ToString(level), [&] {
+			fused.clear();
+			Utils::SoftmaxRowsAbove(logits, Classes, ConfThreshold, fused, 1, mode, level);
+			Bench::DoNotOptimize(fused.size());
+		});
+		Bench::Print(std::cout, result, &baseline);
+
+		twoPasses(level);
+		const auto same = std::equal(begin(expected), end(expected), begin(fused), end(fused), [](const auto& a, const auto& b) {
+			return a.Row == b.Row && a.Col == b.Col && a.Probability == b.Probability;
+		});
+		Bench::Check(same, std::string{ "SoftmaxRowsAbove " } + Utils::ToString(level) + " selects other candidates than SoftmaxRows and the threshold ("
+			+ std::to_string(fused.size()) + " vs " + std::to_string(expected.size()) + ")");
+	}
+	std::cout << "\n";
+}
+
+// MobileNet::Postprocess, the code the demo ships, against the reference: softmax of the whole tensor, every score read
+// where it is, boxes decoded by DecodeBox above, then the suppression and the conversion to pixels of the demo
+static void CheckPostprocess()
+{
+	const auto priors = Utils::MobileNetSsdPriors();
+	const auto logits = RandomLogits();
+	const cv::Size frameSize{ 640, 480 };
+	// the IoU threshold of MobileNetPostprocess
+	const auto iouThreshold = 0.45f;
+
+	DetectorOutputs outputs;
+	outputs.Scores = logits;
+	Utils::SoftmaxRows(outputs.Scores, Classes);
+	std::mt19937 generator{ 7 };
+	std::normal_distribution<float> offset{ 0.0f, 0.5f };
+	outputs.Locations.resize(Priors * 4);
+	for (auto& location : outputs.Locations)
+		location = offset(generator);
+	for (size_t j = 0; j < priors.Size(); ++j)
+		outputs.Priors.insert(end(outputs.Priors), { priors.X[j], priors.Y[j], priors.W[j], priors.H[j] });
+
+	Utils::MultiClassNms nms;
+	ReferenceGather(outputs, nms);
+	std::vector<Utils::Box> expected;
+	for (const auto [cl, k] : nms.Run(iouThreshold))
+	{
+		const auto& candidates = nms.Candidates(cl);
+		Utils::Box box;
+		box.cl = static_cast<int>(cl) - 1;
+		box.prob = candidates.Score[k];
+		box.x = candidates.X1[k] * frameSize.width;
+		box.y = candidates.Y1[k] * frameSize.height;
+		box.w = candidates.X2[k] * frameSize.width - box.x;
+		box.h = candidates.Y2[k] * frameSize.height - box.y;
+		expected.push_back(box);
+	}
+
+	const std::vector<int64_t> shape{ 1, static_cast<int64_t>(Priors), static_cast<int64_t>(Classes) };
+	const auto detections = MobileNet::Postprocess(logits, outputs.Locations, priors, shape, frameSize, ConfThreshold, {});
+	Bench::Check(detections == expected, "MobileNet::Postprocess finds other detections than the reference (" + std::to_string(detections.size())
+		+ " vs " + std::to_string(expected.size()) + ")");
+}
+
+// the generator MobileNet had before the table: std::sqrt at run time, interleaved (x, y, w, h), clamped at the end
+static std::vector<float> PreviousSsdPriors(Utils::span<const Utils::SsdSpec> specs, float imageSize)
+{
+	std::vector<float> priors;
+	for (const auto& spec : specs)
+	{
+		const float scale = imageSize / static_cast<float>(spec.Shrinkage);
+		const int min = spec.BoxHeight > spec.BoxWidth ? spec.BoxWidth : spec.BoxHeight;
+		const int max = spec.BoxHeight < spec.BoxWidth ? spec.BoxWidth : spec.BoxHeight;
+		const float small = min / imageSize;
+		const float big = std::sqrt(static_cast<float>(max) * min) / imageSize;
+		const float ratio1 = std::sqrt(static_cast<float>(spec.Ratio1));
+		const float ratio2 = std::sqrt(static_cast<float>(spec.Ratio2));
+		for (int j = 0; j < spec.FeatureSize; j++)
+		{
+			for (int k = 0; k < spec.FeatureSize; k++)
+			{
+				const float x = (k + 0.5f) / scale;
+				const float y = (j + 0.5f) / scale;
+				priors.insert(end(priors), {
+					x, y, small, small,
+					x, y, big, big,
+					x, y, small * ratio1, small / ratio1,
+					x, y, small / ratio1, small * ratio1,
+					x, y, small * ratio2, small / ratio2,
+					x, y, small / ratio2, small * ratio2 });
+			}
+		}
+	}
+	for (auto& prior : priors)
+		prior = std::clamp(prior, 0.0f, 1.0f);
+	return priors;
+}
+
+// what the first frame of MobileNet used to pay: the table is now computed by the compiler
+static void ComparePriors()
+{
+	std::cout << "SSD priors of MobileNet\n";
+	const auto result = Bench::Run("SsdPriors generated at run time", [&] {
+		Utils::SsdPriors priors{ Utils::MobileNetSsdSpecs, Utils::MobileNetSsdImageSize };
+		Bench::DoNotOptimize(priors.View().X.front());
+	});
+	Bench::Print(std::cout, result);
+
+	// bit for bit: ConstexprSqrt must round like std::sqrt
+	const auto table = Utils::MobileNetSsdPriors();
+	const auto previous = PreviousSsdPriors(Utils::MobileNetSsdSpecs, Utils::MobileNetSsdImageSize);
+	auto same = previous.size() == 4 * table.Size();
+	for (size_t j = 0; same && j < table.Size(); ++j)
+	{
+		const float prior[] = { table.X[j], table.Y[j], table.W[j], table.H[j] };
+		same = std::memcmp(prior, &previous[j * 4], sizeof(prior)) == 0;
+	}
+	Bench::Check(same, "the compile time table of the SSD priors differs from the previous generator");
+	std::cout << "\n";
+}
+
+void Bench::RunDetectionBenchmarks()
+{
+	CompareGather(0.001f);
+	CompareGather(0.01f);
+	CompareLayouts();
+	CompareSoftmaxThreshold(Utils::SoftmaxMode::Exact);
+	CompareSoftmaxThreshold(Utils::SoftmaxMode::Fast);
+	CheckPostprocess();
+	ComparePriors();
+}
@@ -0,0 +1,68 @@
+#include "Benchmarks.h"
+#include "Benchmark.h"
+#include "CpuFeatures.h"
+#include "Histogram.h"
+#include "Instrumentation.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <vector>
+
+// the percentiles of the histogram must not be below the exact ones nor more than one sub-bucket (1/32) above
+static void CheckPercentiles()
+{
+	std::mt19937 generator{ 3 };
+	std::lognormal_distribution<double> latency{ 10.0, 1.5 };
+	std::vector<std::uint64_t> samples(100000);
+	Utils::Histogram histogram;
+	for (auto& sample : samples)
+	{
+		sample = static_cast<std::uint64_t>(latency(generator));
+		histogram.Record(sample);
+	}
+	std::sort(begin(samples), end(samples));
+
+	for (const auto percentile : { 50.0, 90.0, 99.0, 99.9 })
+	{
+		const auto exact = samples[static_cast<size_t>(samples.size() * percentile / 100.0)];
+		const auto estimate = histogram.Percentile(percentile);
+		std::ostringstream what;
+		what << "histogram p" << percentile << " is " << estimate << ", not within 1/32 above the exact " << exact;
+		Bench::Check(estimate >= exact && estimate <= exact + exact / 32 + 1, what.str());
+	}
+}
+
+void Bench::RunInstrumentationBenchmarks()
+{
+	std::cout << "stage timers (" << (Utils::GetCpuFeatures().InvariantTsc ? "TSC" : "steady_clock") << ")\n";
+
+	const auto baseline = Bench::Run("steady_clock pair (previous)", [] {
+		const auto start = std::chrono::steady_clock::now();
+		Bench::DoNotOptimize(std::chrono::steady_clock::now() - start);
+	});
+	Bench::Print(std::cout, baseline);
+
+	const auto timer = Bench::Run("ScopeTimer", [] {
+		Utils::ScopeTimer timer{ Utils::Stage::Run };
+	});
+	Bench::Print(std::cout, timer, &baseline);
+
+	Utils::Histogram histogram;
+	std::uint64_t value = 1;
+	const auto shared = Bench::Run("Histogram::Record", [&] {
+		histogram.Record(value);
+		value = value * 3 % 1000003;
+	});
+	Bench::Print(std::cout, shared);
+
+	const auto unshared = Bench::Run("Histogram::RecordUnshared", [&] {
+		histogram.RecordUnshared(value);
+		value = value * 3 % 1000003;
+	});
+	Bench::Print(std::cout, unshared, &shared);
+
+	CheckPercentiles();
+	std::cout << "\n";
+}
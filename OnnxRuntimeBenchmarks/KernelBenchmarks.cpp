@@ -0,0 +1,244 @@
+#include "Benchmarks.h"
+#include "Benchmark.h"
+#include "Box.h"
+#include "DrawingUtils.h"
+#include "MobileNet.h"
+#include "ResNet.h"
+#include "SsdPriors.h"
+#include "Utils.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <vector>
+
+// the synthetic inputs stand for what the demos feed the kernels: no model nor image file is needed
+static const cv::Size FrameSize{ 640, 480 };
+static const size_t Classes = 91;
+
+static cv::Mat RandomFrame()
+{
+	cv::Mat frame(FrameSize, CV_8UC3);
+	cv::RNG generator{ 42 };
+	generator.fill(frame, cv::RNG::UNIFORM, 0, 256);
+	return frame;
+}
+
+static void BenchmarkSoftmax()
+{
+	std::mt19937 generator{ 42 };
+	std::normal_distribution<float> distribution{ 0.0f, 4.0f };
+	for (const auto size : { 1000u, 91u })
+	{
+		std::vector<float> logits(size);
+		for (auto& logit : logits)
+			logit = distribution(generator);
+		auto scores = logits;
+		Bench::Print(std::cout, Bench::Run("softmax of " + std::to_string(size), [&] {
+			std::copy(begin(logits), end(logits), begin(scores));
+			Utils::softmax(Utils::span<float>{ scores });
+			Bench::DoNotOptimize(scores.front());
+		}));
+	}
+}
+
+// boxes of a few pixels to a third of the frame, in both conventions of Box.h
+template<typename BoxType>
+static std::vector<BoxType> RandomBoxes(size_t count)
+{
+	std::mt19937 generator{ 42 };
+	std::uniform_real_distribution<float> position{ 0.0f, 400.0f };
+	std::uniform_real_distribution<float> size{ 4.0f, 200.0f };
+	std::vector<BoxType> boxes(count);
+	for (auto& box : boxes)
+	{
+		box.x = position(generator);
+		box.y = position(generator);
+		box.w = size(generator);
+		box.h = size(generator);
+	}
+	return boxes;
+}
+
+template<typename BoxType>
+static void BenchmarkIoU(const char* name)
+{
+	const auto boxes = RandomBoxes<BoxType>(1001);
+	Bench::Print(std::cout, Bench::Run(std::string{ name } + " x1000", [&] {
+		auto sum = 0.0f;
+		for (size_t i = 0; i < 1000; ++i)
+			sum += Utils::IoU(boxes[i], boxes[i + 1]);
+		Bench::DoNotOptimize(sum);
+	}));
+}
+
+static void BenchmarkPriors()
+{
+	Bench::Print(std::cout, Bench::Run("SsdPriors (generated at run time)", [] {
+		const Utils::SsdPriors priors{ Utils::MobileNetSsdSpecs, Utils::MobileNetSsdImageSize };
+		Bench::DoNotOptimize(priors.View().X.front());
+	}));
+	Bench::Print(std::cout, Bench::Run("MobileNetSsdPriors (compile-time table)", [] {
+		Bench::DoNotOptimize(Utils::MobileNetSsdPriors().X.front());
+	}));
+}
+
+struct SceneOutputs
+{
+	// [priors, classes] logits, [priors, 4] box offsets
+	std::vector<float> Scores;
+	std::vector<float> Locations;
+};
+
+// the background dominates every prior but a fraction (objects) where one class gets a probability around 0.9
+static SceneOutputs RandomScene(size_t priors, float objects)
+{
+	std::mt19937 generator{ 42 };
+	std::uniform_real_distribution<float> unit{ 0.0f, 1.0f };
+	std::normal_distribution<float> noise{ 0.0f, 1.0f };
+	std::uniform_int_distribution<size_t> objectClass{ 1, Classes - 1 };
+
+	SceneOutputs outputs;
+	outputs.Scores.resize(priors * Classes);
+	for (size_t j = 0; j < priors; ++j)
+	{
+		auto* row = &outputs.Scores[j * Classes];
+		for (size_t cl = 0; cl < Classes; ++cl)
+			row[cl] = noise(generator);
+		row[0] = 8.0f;
+		if (unit(generator) < objects)
+			row[objectClass(generator)] = 10.0f;
+	}
+	outputs.Locations.resize(priors * 4);
+	for (auto& location : outputs.Locations)
+		location = noise(generator) * 0.5f;
+	return outputs;
+}
+
+static void BenchmarkDetection()
+{
+	const auto priors = Utils::MobileNetSsdPriors();
+	const auto outputs = RandomScene(priors.Size(), 0.01f);
+	Bench::Print(std::cout, Bench::Run("DecodeBox of all the priors", [&] {
+		auto sum = 0.0f;
+		for (std::uint32_t j = 0; j < priors.Size(); ++j)
+			sum += MobileNet::DecodeBox(&outputs.Locations[j * 4], priors, j)[0];
+		Bench::DoNotOptimize(sum);
+	}));
+
+	const std::vector<int64_t> shape{ 1, static_cast<int64_t>(priors.Size()), static_cast<int64_t>(Classes) };
+	for (const auto& [scene, objects] : { std::pair{ "sparse", 0.001f }, std::pair{ "medium", 0.01f }, std::pair{ "crowded", 0.1f } })
+	{
+		const auto sceneOutputs = RandomScene(priors.Size(), objects);
+		Utils::NmsOptions options;
+		const auto detections = MobileNet::Postprocess(sceneOutputs.Scores, sceneOutputs.Locations, priors, shape, FrameSize, 0.3f, options).size();
+		Bench::Print(std::cout, Bench::Run(std::string{ "MobileNet::Postprocess " } + scene + " (" + std::to_string(detections) + " detections)", [&] {
+			Bench::DoNotOptimize(MobileNet::Postprocess(sceneOutputs.Scores, sceneOutputs.Locations, priors, shape, FrameSize, 0.3f, options));
+		}));
+	}
+}
+
+static void BenchmarkPreprocessing()
+{
+	const auto frame = RandomFrame();
+	cv::Mat dst;
+	Bench::Print(std::cout, Bench::Run("ResizeToFloat 640x480 -> 224x224", [&] {
+		Utils::ResizeToFloat(frame, dst, { 224, 224 });
+		Bench::DoNotOptimize(dst.data);
+	}));
+	Bench::Print(std::cout, Bench::Run("RemoveMeanDivideByStd 640x480 -> 512x512", [&] {
+		Utils::RemoveMeanDivideByStd(frame, dst, { 512, 512 });
+		Bench::DoNotOptimize(dst.data);
+	}));
+
+	std::vector<float> resNetInput(ResNet::InputSize());
+	Bench::Print(std::cout, Bench::Run("ResNet::PreprocessInto 640x480", [&] {
+		ResNet::PreprocessInto(frame, resNetInput);
+		Bench::DoNotOptimize(resNetInput.front());
+	}));
+	std::vector<float> mobileNetInput(3 * 512 * 512);
+	Bench::Print(std::cout, Bench::Run("MobileNet::PreprocessInto 640x480", [&] {
+		MobileNet::PreprocessInto(frame, mobileNetInput);
+		Bench::DoNotOptimize(mobileNetInput.front());
+	}));
+}
+
+// largest difference between planar (CHW) and the interleaved floats of reference normalized by (x - mean[c]) / std[c]
+static float MaxPlanarDifference(const cv::Mat& reference, const std::array<float, 3>& mean, const std::array<float, 3>& std, const std::vector<float>& planar)
+{
+	const auto planeSize = static_cast<size_t>(reference.rows) * reference.cols;
+	auto difference = 0.0f;
+	for (auto y = 0; y < reference.rows; ++y)
+	{
+		for (auto x = 0; x < reference.cols; ++x)
+		{
+			const auto& pixel = reference.at<cv::Vec3f>(y, x);
+			for (auto c = 0; c < 3; ++c)
+			{
+				const auto expected = (pixel[c] - mean[c]) / std[c];
+				difference = std::max(difference, std::abs(planar[c * planeSize + y * reference.cols + x] - expected));
+			}
+		}
+	}
+	return difference;
+}
+
+// the preprocessing kernels fold the normalization into one multiply-add: checked at every SIMD level against the
+// previous code, ResizeToFloat then the per-channel mean and std for ResNet, RemoveMeanDivideByStd for MobileNet
+static void CheckPreprocessing()
+{
+	const auto frame = RandomFrame();
+	// the ResNet outputs span [-2.2, 2.7] where one ulp is 2.4e-7: the folded constants round differently
+	constexpr auto resNetTolerance = 1e-6f;
+	const auto resNetReference = Utils::ResizeToFloat(frame, { 224, 224 });
+	// (x - 127) / 128 is exact either way
+	const auto mobileNetReference = Utils::RemoveMeanDivideByStd(frame, { 512, 512 });
+
+	std::vector<float> resNetInput(ResNet::InputSize());
+	std::vector<float> mobileNetInput(3 * 512 * 512);
+	for (const auto level : { Utils::SimdLevel::Scalar, Utils::SimdLevel::Sse41, Utils::SimdLevel::Avx2, Utils::SimdLevel::Avx512 })
+	{
+		if (level > Utils::BestSimdLevel())
+			continue;
+		ResNet::PreprocessInto(frame, resNetInput, level);
+		const auto resNetDifference = MaxPlanarDifference(resNetReference, { 0.485f, 0.456f, 0.406f }, { 0.229f, 0.224f, 0.225f }, resNetInput);
+		MobileNet::PreprocessInto(frame, mobileNetInput, level);
+		const auto mobileNetDifference = MaxPlanarDifference(mobileNetReference, { 0.0f, 0.0f, 0.0f }, { 1.0f, 1.0f, 1.0f }, mobileNetInput);
+		std::ostringstream report;
+		report << Utils::ToString(level) << " preprocessing: worst ResNet difference " << resNetDifference << " (bound " << resNetTolerance
+			<< "), worst MobileNet difference " << mobileNetDifference << " (bound 0)";
+		std::cout << report.str() << "\n";
+		Bench::Check(resNetDifference <= resNetTolerance && mobileNetDifference == 0.0f, report.str());
+	}
+}
+
+static void BenchmarkDrawing()
+{
+	auto frame = RandomFrame();
+	const auto colors = Drawing::MakeColors(static_cast<int>(Classes));
+	auto boxes = RandomBoxes<Utils::Box>(20);
+	for (size_t i = 0; i < boxes.size(); ++i)
+	{
+		boxes[i].cl = static_cast<int>(i % (Classes - 1));
+		boxes[i].prob = 0.9f;
+	}
+	Bench::Print(std::cout, Bench::Run("DrawBoundingBoxes of 20 boxes", [&] {
+		Bench::DoNotOptimize(Drawing::DrawBoundingBoxes(frame, boxes, colors).data);
+	}));
+}
+
+void Bench::RunKernelBenchmarks()
+{
+	std::cout << "kernels of the demos\n";
+	BenchmarkSoftmax();
+	BenchmarkIoU<Utils::Box>("IoU(Box, Box)");
+	BenchmarkIoU<Utils::GroundTruthBox>("IoU(GroundTruthBox, GroundTruthBox)");
+	BenchmarkPriors();
+	BenchmarkDetection();
+	CheckPreprocessing();
+	BenchmarkPreprocessing();
+	BenchmarkDrawing();
+	std::cout << "\n";
+}
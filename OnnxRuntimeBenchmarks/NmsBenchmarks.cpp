@@ -0,0 +1,284 @@
+#include "Benchmarks.h"
+#include "Benchmark.h"
+#include "Box.h"
+#include "CpuFeatures.h"
+#include "Nms.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <array>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <utility>
+#include <vector>
+
+static const float IoUThreshold = 0.45f;
+
+// a crowded scene: boxes jittered around a few objects, corners in [0, 1] as decoded by MobileNet
+static Utils::NmsCandidates CrowdedScene(size_t count, unsigned seed = 7)
+{
+	std::mt19937 generator{ seed };
+	std::uniform_real_distribution<float> position{ 0.0f, 0.9f };
+	std::uniform_real_distribution<float> size{ 0.02f, 0.1f };
+	std::normal_distribution<float> jitter{ 0.0f, 0.01f };
+	std::uniform_real_distribution<float> score{ 0.3f, 1.0f };
+
+	std::vector<std::array<float, 4>> objects(std::max<size_t>(count / 50, 1));
+	for (auto& object : objects)
+		object = { position(generator), position(generator), size(generator), size(generator) };
+
+	Utils::NmsCandidates candidates;
+	for (size_t i = 0; i < count; ++i)
+	{
+		const auto& [x, y, w, h] = objects[i % objects.size()];
+		const auto x1 = x + jitter(generator);
+		const auto y1 = y + jitter(generator);
+		candidates.Add(score(generator), x1, y1, x1 + w + jitter(generator), y1 + h + jitter(generator));
+	}
+	return candidates;
+}
+
+// the loop MobileNetPostprocess used to run for each class
+static std::vector<Utils::Box> CopyingNms(const Utils::NmsCandidates& candidates)
+{
+	std::vector<Utils::Box> boxes;
+	for (size_t j = 0; j < candidates.Size(); ++j)
+	{
+		Utils::Box b;
+		b.prob = candidates.Score[j];
+		b.x = candidates.X1[j];
+		b.y = candidates.Y1[j];
+		b.w = candidates.X2[j];
+		b.h = candidates.Y2[j];
+		boxes.push_back(b);
+	}
+	std::sort(boxes.begin(), boxes.end(), Utils::GreaterProbability);
+
+	std::vector<Utils::Box> detected;
+	std::vector<Utils::Box> remaining;
+	while (!boxes.empty())
+	{
+		remaining.clear();
+		detected.push_back(boxes[0]);
+		for (size_t j = 1; j < boxes.size(); j++)
+		{
+			if (Utils::IoU(boxes[0], boxes[j]) <= IoUThreshold)
+				remaining.push_back(boxes[j]);
+		}
+		boxes = remaining;
+	}
+	return detected;
+}
+
+static bool SameDetections(const std::vector<Utils::Box>& expected, const Utils::NmsCandidates& candidates, const std::vector<std::uint32_t>& kept)
+{
+	if (expected.size() != kept.size())
+		return false;
+	for (size_t i = 0; i < kept.size(); ++i)
+	{
+		const auto k = kept[i];
+		if (expected[i].prob != candidates.Score[k] || expected[i].x != candidates.X1[k] || expected[i].y != candidates.Y1[k])
+			return false;
+	}
+	return true;
+}
+
+static const char* ToString(Utils::NmsMode mode)
+{
+	switch (mode)
+	{
+	case Utils::NmsMode::Batched: return "batched";
+	case Utils::NmsMode::ParallelPerClass: return "parallel per class";
+	default: return "per class";
+	}
+}
+
+// detections kept by only one of a and b
+static size_t DifferingDetections(const std::vector<Utils::MultiClassNms::Detection>& a, const std::vector<Utils::MultiClassNms::Detection>& b)
+{
+	const auto sorted = [](const std::vector<Utils::MultiClassNms::Detection>& detections) {
+		std::vector<std::pair<std::uint32_t, std::uint32_t>> pairs;
+		for (const auto& detection : detections)
+			pairs.emplace_back(detection.Class, detection.Index);
+		std::sort(begin(pairs), end(pairs));
+		return pairs;
+	};
+	const auto x = sorted(a);
+	const auto y = sorted(b);
+	std::vector<std::pair<std::uint32_t, std::uint32_t>> difference;
+	std::set_symmetric_difference(begin(x), end(x), begin(y), end(y), std::back_inserter(difference));
+	return difference.size();
+}
+
+// a crowded frame with many active classes, as MobileNetPostprocess sees it
+static void CompareMultiClass(size_t classes, size_t candidatesPerClass)
+{
+	std::cout << "NMS of " << classes << " classes of " << candidatesPerClass << " candidates\n";
+	std::vector<Utils::NmsCandidates> scene;
+	for (size_t cl = 0; cl < classes; ++cl)
+		scene.push_back(CrowdedScene(candidatesPerClass, static_cast<unsigned>(cl)));
+
+	Utils::ThreadPool pool;
+	std::vector<Utils::MultiClassNms::Detection> reference;
+	const Bench::Result* baseline = nullptr;
+	Bench::Result perClass;
+	for (const auto mode : { Utils::NmsMode::PerClass, Utils::NmsMode::Batched, Utils::NmsMode::ParallelPerClass })
+	{
+		Utils::MultiClassNms nms{ mode, &pool };
+		const auto fill = [&] {
+			nms.Clear(classes);
+			for (size_t cl = 0; cl < classes; ++cl)
+				nms.Candidates(cl) = scene[cl];
+		};
+		const auto result = Bench::Run(std::string{ "MultiClassNms " } + ToString(mode), [&] {
+			fill();
+			Bench::DoNotOptimize(nms.Run(IoUThreshold));
+		});
+		Bench::Print(std::cout, result, baseline);
+
+		fill();
+		const auto& detections = nms.Run(IoUThreshold);
+		if (!baseline)
+		{
+			perClass = result;
+			baseline = &perClass;
+			reference = detections;
+			continue;
+		}
+		const auto differing = DifferingDetections(reference, detections);
+		if (mode == Utils::NmsMode::Batched)
+		{
+			// the shift by class rounds the coordinates: a few boxes near the threshold go the other way
+			std::cout << "  " << differing << " detections differ from per class (" << detections.size() << " vs " << reference.size() << ")\n";
+		}
+		else
+		{
+			Bench::Check(differing == 0, std::string{ "MultiClassNms " } + ToString(mode) + ": " + std::to_string(differing) + " detections differ from per class");
+		}
+	}
+	std::cout << "\n";
+}
+
+// greedy against Fast-NMS on the best topK candidates, at each SIMD level the machine supports
+static void CompareMatrix(size_t count, size_t topK)
+{
+	std::cout << "greedy and matrix NMS of " << count << " candidates (top " << topK << ")\n";
+	const auto candidates = CrowdedScene(count);
+
+	Utils::NmsEngine engine;
+	const auto greedy = Bench::Run("greedy", [&] {
+		engine.Candidates = candidates;
+		Bench::DoNotOptimize(engine.Run(IoUThreshold));
+	});
+	Bench::Print(std::cout, greedy);
+	engine.Candidates = candidates;
+	auto greedyKept = engine.Run(IoUThreshold);
+	std::sort(begin(greedyKept), end(greedyKept));
+
+	std::vector<std::uint32_t> scalarKept;
+	for (const auto level : { Utils::SimdLevel::Scalar, Utils::SimdLevel::Avx2, Utils::SimdLevel::Avx512 })
+	{
+		if (level > Utils::BestSimdLevel())
+			break;
+		const auto result = Bench::Run(std::string{ "matrix " } + Utils::ToString(level), [&] {
+			engine.Candidates = candidates;
+			Bench::DoNotOptimize(engine.RunMatrix(IoUThreshold, topK, level));
+		});
+		Bench::Print(std::cout, result, &greedy);
+
+		engine.Candidates = candidates;
+		auto kept = engine.RunMatrix(IoUThreshold, topK, level);
+		std::sort(begin(kept), end(kept));
+		if (level == Utils::SimdLevel::Scalar)
+		{
+			scalarKept = kept;
+			std::vector<std::uint32_t> common;
+			std::set_intersection(begin(kept), end(kept), begin(greedyKept), end(greedyKept), std::back_inserter(common));
+			std::cout << "  kept " << kept.size() << " vs " << greedyKept.size() << " by greedy, " << common.size() << " in common\n";
+		}
+		else
+		{
+			Bench::Check(kept == scalarKept, std::string{ "matrix NMS " } + Utils::ToString(level) + " keeps other boxes than scalar");
+		}
+	}
+	std::cout << "\n";
+}
+
+// one box against a set, for both conventions of Box.h: pair by pair against the SIMD kernels
+template <class BoxType>
+static void CompareIoU(const char* convention, size_t count)
+{
+	std::cout << "IoU of one box with " << count << " boxes (" << convention << ")\n";
+	const auto candidates = CrowdedScene(count);
+	Utils::BoxSet set;
+	std::vector<BoxType> boxes(count);
+	for (size_t i = 0; i < count; ++i)
+	{
+		// the corners of the scene serve as (x, y, w, h) for the center convention too: any box will do
+		set.Add(candidates.X1[i], candidates.Y1[i], candidates.X2[i], candidates.Y2[i]);
+		boxes[i].x = set.X[i];
+		boxes[i].y = set.Y[i];
+		boxes[i].w = set.W[i];
+		boxes[i].h = set.H[i];
+	}
+	const auto& box = boxes[count / 2];
+
+	std::vector<float> expected(count);
+	const auto baseline = Bench::Run("pair by pair", [&] {
+		for (size_t i = 0; i < count; ++i)
+			expected[i] = Utils::IoU(box, boxes[i]);
+		Bench::DoNotOptimize(expected.front());
+	});
+	Bench::Print(std::cout, baseline);
+
+	std::vector<float> result(count);
+	for (const auto level : { Utils::SimdLevel::Scalar, Utils::SimdLevel::Avx2, Utils::SimdLevel::Avx512 })
+	{
+		if (level > Utils::BestSimdLevel())
+			break;
+		const auto run = Bench::Run(std::string{ "BoxSet " } + Utils::ToString(level), [&] {
+			Bench::DoNotOptimize(Utils::IoU(box, set, result, 0, level).front());
+		});
+		Bench::Print(std::cout, run, &baseline);
+		Bench::Check(result == expected, std::string{ "BoxSet IoU " } + Utils::ToString(level) + " differs from pair by pair (" + convention + ")");
+	}
+	std::cout << "\n";
+}
+
+void Bench::RunNmsBenchmarks()
+{
+	CompareIoU<Utils::Box>("corners", 1000);
+	CompareIoU<Utils::GroundTruthBox>("center", 1000);
+
+	for (const auto count : { 1000u, 4000u, 8000u })
+	{
+		std::cout << "NMS of " << count << " candidates of one class\n";
+		const auto candidates = CrowdedScene(count);
+
+		const auto baseline = Bench::Run("copying NMS (previous)", [&] {
+			Bench::DoNotOptimize(CopyingNms(candidates));
+		});
+		Bench::Print(std::cout, baseline);
+
+		Utils::NmsEngine engine;
+		const auto result = Bench::Run("NmsEngine (reused)", [&] {
+			engine.Candidates = candidates;
+			Bench::DoNotOptimize(engine.Run(IoUThreshold));
+		});
+		Bench::Print(std::cout, result, &baseline);
+
+		engine.Candidates = candidates;
+		Bench::Check(SameDetections(CopyingNms(candidates), candidates, engine.Run(IoUThreshold)),
+			"NmsEngine keeps other boxes than the copying NMS of " + std::to_string(count) + " candidates");
+		std::cout << "\n";
+	}
+
+	// typical frame: every class has a few candidates, the per class overhead dominates
+	CompareMultiClass(90, 20);
+	// crowded frame: the suppressions themselves dominate
+	CompareMultiClass(90, 500);
+
+	CompareMatrix(1000, 200);
+	CompareMatrix(8000, 200);
+	CompareMatrix(8000, 1000);
+}
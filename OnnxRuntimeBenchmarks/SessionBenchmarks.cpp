@@ -0,0 +1,109 @@
+#include "Benchmarks.h"
+#include "Benchmark.h"
+#include "ModelRegistry.h"
+#include "SteadyStateSession.h"
+#include "Utils.h"
+#include "WritableTensor.h"
+#include <algorithm>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+// tiny enough that Session::Run is all fixed cost: name lookups, tensor creation, output allocation, pool wake-ups
+static const std::filesystem::path LinearModel = LR"(..\OnnxRuntimeDemo\data\linear.onnx)";
+
+// long runs: the variants differ by fractions of a microsecond
+static const std::chrono::milliseconds RunTime{ 1000 };
+
+static std::vector<const char*> NamePointers(const std::vector<std::string>& names)
+{
+	std::vector<const char*> pointers;
+	for (const auto& name : names)
+		pointers.push_back(name.c_str());
+	return pointers;
+}
+
+static std::vector<float> FirstOutput(const Ort::Value& output)
+{
+	const auto* data = output.GetTensorData<float>();
+	return { data, data + output.GetTensorTypeAndShapeInfo().GetElementCount() };
+}
+
+static void CompareRunOverhead(int intraOpThreads)
+{
+	Ort::SessionOptions options;
+	options.SetIntraOpNumThreads(intraOpThreads);
+	Utils::Model model{ Utils::ModelRegistry::Instance().Env(), LinearModel, options };
+	std::cout << "Session::Run of linear.onnx, " << intraOpThreads << " intra-op threads\n";
+
+	const auto inputShape = Utils::ResolveShape(model.Inputs[0]);
+	std::vector<float> inputValues(std::accumulate(begin(inputShape), end(inputShape), std::int64_t{ 1 }, std::multiplies<>{}), 1.0f);
+	const auto memoryInfo = Ort::MemoryInfo::CreateCpu(OrtDeviceAllocator, OrtMemTypeCPU);
+
+	// what RunLinearRegression used to do on each call: ask the session for the names, wrap the input, let ORT allocate the outputs
+	const auto baseline = Bench::Run("names looked up on each call (previous)", [&] {
+		const auto inputNames = Utils::OnnxGetInputNames(model.Session);
+		const auto outputNames = Utils::OnnxGetOutputNames(model.Session);
+		const auto info = Ort::MemoryInfo::CreateCpu(OrtDeviceAllocator, OrtMemTypeCPU);
+		auto input = Ort::Value::CreateTensor<float>(info, inputValues.data(), inputValues.size(), inputShape.data(), inputShape.size());
+		auto outputs = model.Session.Run(Ort::RunOptions{ nullptr }, NamePointers(inputNames).data(), &input, 1, NamePointers(outputNames).data(), outputNames.size());
+		Bench::DoNotOptimize(outputs.front());
+	}, RunTime);
+	Bench::Print(std::cout, baseline);
+
+	// the pattern of RunLinearRegression now: the names come from Utils::Model
+	const auto cached = Bench::Run("cached names (Model::Run)", [&] {
+		auto input = Ort::Value::CreateTensor<float>(memoryInfo, inputValues.data(), inputValues.size(), inputShape.data(), inputShape.size());
+		auto outputs = model.Run(&input, 1);
+		Bench::DoNotOptimize(outputs.front());
+	}, RunTime);
+	Bench::Print(std::cout, cached, &baseline);
+
+	// input and outputs created once and passed to the overload of Run that writes into existing values
+	auto input = Ort::Value::CreateTensor<float>(memoryInfo, inputValues.data(), inputValues.size(), inputShape.data(), inputShape.size());
+	std::vector<Ort::Value> outputs;
+	for (const auto& info : model.Outputs)
+		outputs.push_back(std::move(Utils::AllocateTensor(Utils::ResolveShape(info)).Value));
+	const Ort::RunOptions runOptions;
+	const auto reused = Bench::Run("reused output values", [&] {
+		model.Session.Run(runOptions, model.InputNames.data(), &input, 1, model.OutputNames.data(), outputs.data(), outputs.size());
+		Bench::DoNotOptimize(outputs.front());
+	}, RunTime);
+	Bench::Print(std::cout, reused, &baseline);
+
+	Utils::SteadyStateSession session{ model };
+	std::fill(session.Input().begin(), session.Input().end(), 1.0f);
+	const auto bound = Bench::Run("IoBinding (SteadyStateSession)", [&] {
+		session.Run();
+		Bench::DoNotOptimize(session.Output().front());
+	}, RunTime);
+	Bench::Print(std::cout, bound, &baseline);
+
+	const auto expected = FirstOutput(model.Run(&input, 1).front());
+	const bool same = FirstOutput(outputs.front()) == expected
+		&& std::equal(session.Output().begin(), session.Output().end(), expected.begin(), expected.end());
+	Bench::Check(same, "the variants of Session::Run give different outputs (" + std::to_string(intraOpThreads) + " intra-op threads)");
+	std::cout << "\n";
+}
+
+void Bench::RunSessionBenchmarks()
+{
+	if (!std::filesystem::exists(LinearModel))
+	{
+		std::cout << "Session::Run benchmarks skipped: " << LinearModel.string() << " not found\n\n";
+		return;
+	}
+
+	// the fixed cost grows with the pool the session wakes up on every run
+	std::vector<int> threadCounts{ 1, 2, 4, static_cast<int>(std::thread::hardware_concurrency()) };
+	std::sort(begin(threadCounts), end(threadCounts));
+	threadCounts.erase(std::unique(begin(threadCounts), end(threadCounts)), end(threadCounts));
+	for (const auto threads : threadCounts)
+	{
+		if (threads > 0)
+			CompareRunOverhead(threads);
+	}
+}
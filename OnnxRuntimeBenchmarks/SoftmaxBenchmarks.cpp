@@ -0,0 +1,102 @@
+#include "Benchmarks.h"
+#include "Benchmark.h"
+#include "Softmax.h"
+#include "Classification.h"
+#include "Utils.h"
+#include <iostream>
+#include <random>
+#include <vector>
+
+static std::vector<float> RandomLogits(size_t count)
+{
+	std::mt19937 generator{ 42 };
+	std::normal_distribution<float> distribution{ 0.0f, 4.0f };
+	std::vector<float> logits(count);
+	for (auto& logit : logits)
+		logit = distribution(generator);
+	return logits;
+}
+
+static std::vector<Utils::SimdLevel> SupportedLevels()
+{
+	std::vector<Utils::SimdLevel> levels{ Utils::SimdLevel::Scalar };
+	const auto& features = Utils::GetCpuFeatures();
+	if (features.Avx2)
+		levels.push_back(Utils::SimdLevel::Avx2);
+	if (features.Avx512)
+		levels.push_back(Utils::SimdLevel::Avx512);
+	return levels;
+}
+
+static const char* ToString(Utils::SoftmaxMode mode)
+{
+	return mode == Utils::SoftmaxMode::Fast ? "fast" : "exact";
+}
+
+// every op starts by copying the logits (the softmax is in place), the copy is the same for all the variants
+static void CompareSoftmax(const char* title, size_t rows, size_t cols)
+{
+	std::cout << title << " [" << rows << ", " << cols << "]\n";
+	const auto logits = RandomLogits(rows * cols);
+	auto scores = logits;
+
+	const auto baseline = Bench::Run("softmax template (per row)", [&] {
+		std::copy(begin(logits), end(logits), begin(scores));
+		for (size_t row = 0; row < rows; ++row)
+			Utils::softmax(Utils::span<float>{ scores.data() + row * cols, cols });
+		Bench::DoNotOptimize(scores.front());
+	});
+	Bench::Print(std::cout, baseline);
+
+	for (const auto mode : { Utils::SoftmaxMode::Exact, Utils::SoftmaxMode::Fast })
+	{
+		for (const auto level : SupportedLevels())
+		{
+			const auto name = std::string{ "SoftmaxRows " } + ToString(mode) + " " + Utils::ToString(level);
+			const auto result = Bench::Run(name, [&] {
+				std::copy(begin(logits), end(logits), begin(scores));
+				Utils::SoftmaxRows(scores, cols, mode, level);
+				Bench::DoNotOptimize(scores.front());
+			});
+			Bench::Print(std::cout, result, &baseline);
+		}
+	}
+	std::cout << "\n";
+}
+
+// what RunResNet needs for each image: the best class and its probability
+static void CompareTop1(size_t classes)
+{
+	std::cout << "top-1 of " << classes << " logits\n";
+	const auto logits = RandomLogits(classes);
+	const std::vector<std::string> labels(classes, "label");
+	auto scores = logits;
+
+	const auto baseline = Bench::Run("softmax template + max_element", [&] {
+		std::copy(begin(logits), end(logits), begin(scores));
+		Utils::softmax(Utils::span<float>{ scores });
+		const auto best = std::max_element(begin(scores), end(scores));
+		Bench::DoNotOptimize(labels[std::distance(begin(scores), best)]);
+		Bench::DoNotOptimize(*best);
+	});
+	Bench::Print(std::cout, baseline);
+
+	for (const auto mode : { Utils::SoftmaxMode::Exact, Utils::SoftmaxMode::Fast })
+	{
+		const auto result = Bench::Run(std::string{ "TopK(1) " } + ToString(mode), [&] {
+			Bench::DoNotOptimize(Utils::TopK(logits, labels, 1, mode));
+		});
+		Bench::Print(std::cout, result, &baseline);
+	}
+	std::cout << "\n";
+}
+
+void Bench::RunSoftmaxBenchmarks()
+{
+	// ResNet: one row of 1000 classes per image
+	CompareSoftmax("ResNet scores", 1, 1000);
+	// MobileNet SSD: 8190 candidates of 91 classes per image
+	CompareSoftmax("MobileNet scores", 8190, 91);
+	// ResNet top-1 without normalizing the whole output
+	CompareTop1(1000);
+}
@@ -0,0 +1,25 @@
+#include <iostream>
+#include "Benchmarks.h"
+#include "CpuFeatures.h"
+
+using namespace std;
+
+int main()
+{
+	try
+	{
+		cout << "best SIMD level: " << Utils::ToString(Utils::BestSimdLevel()) << "\n\n";
+
+		Bench::RunKernelBenchmarks();
+		Bench::RunSoftmaxBenchmarks();
+		Bench::RunNmsBenchmarks();
+		Bench::RunDetectionBenchmarks();
+		Bench::RunInstrumentationBenchmarks();
+		Bench::RunSessionBenchmarks();
+	}
+	catch (const exception& e)
+	{
+		cerr << e.what() << "\n";
+		return 1;
+	}
+}
@@ -1,7 +1,16 @@
 #include "Box.h"
+#include <stdexcept>
+#include <immintrin.h>
 
 #include "Utils.h"
 
+// the SIMD kernels must agree bit for bit with the IoU of one pair: no fused multiply and add
+#if defined(__clang__)
+#pragma STDC FP_CONTRACT OFF
+#elif defined(__GNUC__)
+#pragma GCC optimize("fp-contract=off")
+#endif
+
 Utils::GroundTruthBox Utils::ClearTruth(GroundTruthBox g)
 {
 	g.unique_truth_index = -1;
@@ -59,3 +68,215 @@ float Utils::IoU(const Utils::GroundTruthBox& a, const Utils::GroundTruthBox& b)
 		return 0;
 	return I / U;
 }
+
+void Utils::BoxSet::Clear()
+{
+	X.clear();
+	Y.clear();
+	W.clear();
+	H.clear();
+}
+
+void Utils::BoxSet::Add(float x, float y, float w, float h)
+{
+	X.push_back(x);
+	Y.push_back(y);
+	W.push_back(w);
+	H.push_back(h);
+}
+
+void Utils::BoxSet::Add(const Box& b)
+{
+	Add(b.x, b.y, b.w, b.h);
+}
+
+size_t Utils::BoxSet::Size() const
+{
+	return X.size();
+}
+
+template <class BoxType>
+static void IoUScalar(const BoxType& box, const Utils::BoxSet& set, size_t begin, size_t end, float* result)
+{
+	for (auto j = begin; j < end; ++j)
+	{
+		BoxType other;
+		other.x = set.X[j];
+		other.y = set.Y[j];
+		other.w = set.W[j];
+		other.h = set.H[j];
+		result[j - begin] = Utils::IoU(box, other);
+	}
+}
+
+UTILS_TARGET("avx2")
+static void IoUCornersAvx2(const Utils::Box& box, const Utils::BoxSet& set, size_t begin, size_t end, float* result)
+{
+	const auto x1 = _mm256_set1_ps(box.x);
+	const auto y1 = _mm256_set1_ps(box.y);
+	const auto x2 = _mm256_set1_ps(box.w);
+	const auto y2 = _mm256_set1_ps(box.h);
+	const auto zero = _mm256_setzero_ps();
+	const auto area = _mm256_mul_ps(_mm256_max_ps(_mm256_sub_ps(y2, y1), zero), _mm256_max_ps(_mm256_sub_ps(x2, x1), zero));
+	const auto epsilon = _mm256_set1_ps(1e-5f);
+
+	auto j = begin;
+	for (; j + 8 <= end; j += 8)
+	{
+		const auto ox1 = _mm256_loadu_ps(set.X.data() + j);
+		const auto oy1 = _mm256_loadu_ps(set.Y.data() + j);
+		const auto ox2 = _mm256_loadu_ps(set.W.data() + j);
+		const auto oy2 = _mm256_loadu_ps(set.H.data() + j);
+
+		const auto ao_w = _mm256_max_ps(_mm256_sub_ps(_mm256_min_ps(x2, ox2), _mm256_max_ps(x1, ox1)), zero);
+		const auto ao_h = _mm256_max_ps(_mm256_sub_ps(_mm256_min_ps(y2, oy2), _mm256_max_ps(y1, oy1)), zero);
+		const auto area_overlap = _mm256_mul_ps(ao_w, ao_h);
+		const auto other = _mm256_mul_ps(_mm256_max_ps(_mm256_sub_ps(oy2, oy1), zero), _mm256_max_ps(_mm256_sub_ps(ox2, ox1), zero));
+		const auto denominator = _mm256_add_ps(_mm256_sub_ps(_mm256_add_ps(area, other), area_overlap), epsilon);
+		_mm256_storeu_ps(result + j - begin, _mm256_div_ps(area_overlap, denominator));
+	}
+	IoUScalar(box, set, j, end, result + j - begin);
+}
+
+UTILS_TARGET("avx512f")
+static void IoUCornersAvx512(const Utils::Box& box, const Utils::BoxSet& set, size_t begin, size_t end, float* result)
+{
+	const auto x1 = _mm512_set1_ps(box.x);
+	const auto y1 = _mm512_set1_ps(box.y);
+	const auto x2 = _mm512_set1_ps(box.w);
+	const auto y2 = _mm512_set1_ps(box.h);
+	const auto zero = _mm512_setzero_ps();
+	const auto area = _mm512_mul_ps(_mm512_max_ps(_mm512_sub_ps(y2, y1), zero), _mm512_max_ps(_mm512_sub_ps(x2, x1), zero));
+	const auto epsilon = _mm512_set1_ps(1e-5f);
+
+	for (auto j = begin; j < end; j += 16)
+	{
+		// the last boxes are read and written through a mask
+		const auto mask = static_cast<__mmask16>(end - j >= 16 ? 0xffff : (1u << (end - j)) - 1);
+		const auto ox1 = _mm512_maskz_loadu_ps(mask, set.X.data() + j);
+		const auto oy1 = _mm512_maskz_loadu_ps(mask, set.Y.data() + j);
+		const auto ox2 = _mm512_maskz_loadu_ps(mask, set.W.data() + j);
+		const auto oy2 = _mm512_maskz_loadu_ps(mask, set.H.data() + j);
+
+		const auto ao_w = _mm512_max_ps(_mm512_sub_ps(_mm512_min_ps(x2, ox2), _mm512_max_ps(x1, ox1)), zero);
+		const auto ao_h = _mm512_max_ps(_mm512_sub_ps(_mm512_min_ps(y2, oy2), _mm512_max_ps(y1, oy1)), zero);
+		const auto area_overlap = _mm512_mul_ps(ao_w, ao_h);
+		const auto other = _mm512_mul_ps(_mm512_max_ps(_mm512_sub_ps(oy2, oy1), zero), _mm512_max_ps(_mm512_sub_ps(ox2, ox1), zero));
+		const auto denominator = _mm512_add_ps(_mm512_sub_ps(_mm512_add_ps(area, other), area_overlap), epsilon);
+		_mm512_mask_storeu_ps(result + j - begin, mask, _mm512_div_ps(area_overlap, denominator));
+	}
+}
+
+UTILS_TARGET("avx2")
+static void IoUCenterAvx2(const Utils::GroundTruthBox& box, const Utils::BoxSet& set, size_t begin, size_t end, float* result)
+{
+	const auto half = _mm256_set1_ps(0.5f);
+	const auto x = _mm256_set1_ps(box.x);
+	const auto y = _mm256_set1_ps(box.y);
+	const auto w = _mm256_set1_ps(box.w);
+	const auto h = _mm256_set1_ps(box.h);
+	const auto left = _mm256_sub_ps(x, _mm256_mul_ps(w, half));
+	const auto right = _mm256_add_ps(x, _mm256_mul_ps(w, half));
+	const auto top = _mm256_sub_ps(y, _mm256_mul_ps(h, half));
+	const auto bottom = _mm256_add_ps(y, _mm256_mul_ps(h, half));
+	const auto area = _mm256_mul_ps(w, h);
+	const auto zero = _mm256_setzero_ps();
+
+	auto j = begin;
+	for (; j + 8 <= end; j += 8)
+	{
+		const auto ox = _mm256_loadu_ps(set.X.data() + j);
+		const auto oy = _mm256_loadu_ps(set.Y.data() + j);
+		const auto ow = _mm256_loadu_ps(set.W.data() + j);
+		const auto oh = _mm256_loadu_ps(set.H.data() + j);
+
+		// x / 2 and x * 0.5 round the same way
+		const auto iw = _mm256_sub_ps(_mm256_min_ps(right, _mm256_add_ps(ox, _mm256_mul_ps(ow, half))), _mm256_max_ps(left, _mm256_sub_ps(ox, _mm256_mul_ps(ow, half))));
+		const auto ih = _mm256_sub_ps(_mm256_min_ps(bottom, _mm256_add_ps(oy, _mm256_mul_ps(oh, half))), _mm256_max_ps(top, _mm256_sub_ps(oy, _mm256_mul_ps(oh, half))));
+		const auto disjoint = _mm256_or_ps(_mm256_cmp_ps(iw, zero, _CMP_LT_OQ), _mm256_cmp_ps(ih, zero, _CMP_LT_OQ));
+		const auto intersection = _mm256_andnot_ps(disjoint, _mm256_mul_ps(iw, ih));
+		const auto unionArea = _mm256_sub_ps(_mm256_add_ps(area, _mm256_mul_ps(ow, oh)), intersection);
+		const auto empty = _mm256_or_ps(_mm256_cmp_ps(intersection, zero, _CMP_EQ_OQ), _mm256_cmp_ps(unionArea, zero, _CMP_EQ_OQ));
+		_mm256_storeu_ps(result + j - begin, _mm256_andnot_ps(empty, _mm256_div_ps(intersection, unionArea)));
+	}
+	IoUScalar(box, set, j, end, result + j - begin);
+}
+
+UTILS_TARGET("avx512f")
+static void IoUCenterAvx512(const Utils::GroundTruthBox& box, const Utils::BoxSet& set, size_t begin, size_t end, float* result)
+{
+	const auto half = _mm512_set1_ps(0.5f);
+	const auto x = _mm512_set1_ps(box.x);
+	const auto y = _mm512_set1_ps(box.y);
+	const auto w = _mm512_set1_ps(box.w);
+	const auto h = _mm512_set1_ps(box.h);
+	const auto left = _mm512_sub_ps(x, _mm512_mul_ps(w, half));
+	const auto right = _mm512_add_ps(x, _mm512_mul_ps(w, half));
+	const auto top = _mm512_sub_ps(y, _mm512_mul_ps(h, half));
+	const auto bottom = _mm512_add_ps(y, _mm512_mul_ps(h, half));
+	const auto area = _mm512_mul_ps(w, h);
+	const auto zero = _mm512_setzero_ps();
+
+	for (auto j = begin; j < end; j += 16)
+	{
+		const auto mask = static_cast<__mmask16>(end - j >= 16 ? 0xffff : (1u << (end - j)) - 1);
+		const auto ox = _mm512_maskz_loadu_ps(mask, set.X.data() + j);
+		const auto oy = _mm512_maskz_loadu_ps(mask, set.Y.data() + j);
+		const auto ow = _mm512_maskz_loadu_ps(mask, set.W.data() + j);
+		const auto oh = _mm512_maskz_loadu_ps(mask, set.H.data() + j);
+
+		const auto iw = _mm512_sub_ps(_mm512_min_ps(right, _mm512_add_ps(ox, _mm512_mul_ps(ow, half))), _mm512_max_ps(left, _mm512_sub_ps(ox, _mm512_mul_ps(ow, half))));
+		const auto ih = _mm512_sub_ps(_mm512_min_ps(bottom, _mm512_add_ps(oy, _mm512_mul_ps(oh, half))), _mm512_max_ps(top, _mm512_sub_ps(oy, _mm512_mul_ps(oh, half))));
+		const auto overlapping = _mm512_cmp_ps_mask(iw, zero, _CMP_GE_OQ) & _mm512_cmp_ps_mask(ih, zero, _CMP_GE_OQ);
+		const auto intersection = _mm512_maskz_mul_ps(overlapping, iw, ih);
+		const auto unionArea = _mm512_sub_ps(_mm512_add_ps(area, _mm512_mul_ps(ow, oh)), intersection);
+		const auto nonEmpty = _mm512_cmp_ps_mask(intersection, zero, _CMP_NEQ_UQ) & _mm512_cmp_ps_mask(unionArea, zero, _CMP_NEQ_UQ);
+		_mm512_mask_storeu_ps(result + j - begin, mask, _mm512_maskz_div_ps(nonEmpty, intersection, unionArea));
+	}
+}
+
+static void CheckIoUArguments(const Utils::BoxSet& set, Utils::span<float> result, size_t first)
+{
+	if (first > set.Size() || result.size() < set.Size() - first)
+	{
+		throw std::invalid_argument("IoU: first is past the end of the set or result is too small");
+	}
+}
+
+Utils::span<float> Utils::IoU(const Box& box, const BoxSet& set, span<float> result, size_t first, SimdLevel level)
+{
+	CheckIoUArguments(set, result, first);
+	const auto end = set.Size();
+	switch (level)
+	{
+	case SimdLevel::Avx2:
+		IoUCornersAvx2(box, set, first, end, result.data());
+		break;
+	case SimdLevel::Avx512:
+		IoUCornersAvx512(box, set, first, end, result.data());
+		break;
+	default:
+		IoUScalar(box, set, first, end, result.data());
+		break;
+	}
+	return result.first(end - first);
+}
+
+Utils::span<float> Utils::IoU(const GroundTruthBox& box, const BoxSet& set, span<float> result, size_t first, SimdLevel level)
+{
+	CheckIoUArguments(set, result, first);
+	const auto end = set.Size();
+	switch (level)
+	{
+	case SimdLevel::Avx2:
+		IoUCenterAvx2(box, set, first, end, result.data());
+		break;
+	case SimdLevel::Avx512:
+		IoUCenterAvx512(box, set, first, end, result.data());
+		break;
+	default:
+		IoUScalar(box, set, first, end, result.data());
+		break;
+	}
+	return result.first(end - first);
+}
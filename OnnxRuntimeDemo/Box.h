@@ -2,6 +2,8 @@
 #include <string>
 #include <vector>
 #include <tuple>
+#include "span.h"
+#include "CpuFeatures.h"
 
 namespace Utils
 {
@@ -66,4 +68,24 @@ namespace Utils
     float Union(const GroundTruthBox& a, const GroundTruthBox& b);
 
     float IoU(const GroundTruthBox& a, const GroundTruthBox& b);
+
+    // boxes as a structure of arrays, with the fields of Box: the convention (corners or center) is the one of the IoU called
+    struct BoxSet
+    {
+        std::vector<float> X;
+        std::vector<float> Y;
+        std::vector<float> W;
+        std::vector<float> H;
+
+        void Clear();
+        void Add(float x, float y, float w, float h);
+        void Add(const Box& b);
+        size_t Size() const;
+    };
+
+    // IoU of box with each box of set from first on, written to the front of result (which must be large enough)
+    // corners (x1, y1, x2, y2) in (x, y, w, h): the same values as IoU(const Box&, const Box&)
+    span<float> IoU(const Box& box, const BoxSet& set, span<float> result, size_t first = 0, SimdLevel level = BestSimdLevel());
+    // center (x, y) and size (w, h): the same values as IoU(const GroundTruthBox&, const GroundTruthBox&)
+    span<float> IoU(const GroundTruthBox& box, const BoxSet& set, span<float> result, size_t first = 0, SimdLevel level = BestSimdLevel());
 }
\ No newline at end of file
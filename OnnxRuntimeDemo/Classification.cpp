@@ -0,0 +1,51 @@
+#include "Classification.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+std::vector<Utils::Classification> Utils::TopK(span<const float> logits, const std::vector<std::string>& labels, size_t k, SoftmaxMode mode)
+{
+	k = std::min(k, logits.size());
+	if (k == 0)
+		return {};
+
+	// sorted by decreasing logit, a new candidate enters only if it beats the current k-th (rare after the first few)
+	std::vector<std::pair<float, size_t>> best;
+	best.reserve(k + 1);
+	for (auto i = 0u; i < logits.size(); ++i)
+	{
+		const auto logit = logits[i];
+		if (best.size() == k && !(logit > best.back().first))
+			continue;
+		const auto position = std::upper_bound(begin(best), end(best), logit, [](auto value, const auto& entry) {
+			return value > entry.first;
+		});
+		best.insert(position, { logit, i });
+		if (best.size() > k)
+			best.pop_back();
+	}
+
+	const auto logSumExp = LogSumExp(logits, mode);
+	std::vector<Classification> out;
+	out.reserve(k);
+	for (const auto& [logit, idx] : best)
+	{
+		out.push_back({ idx, idx < labels.size() ? labels[idx] : std::string{}, std::exp(logit - logSumExp) });
+	}
+	return out;
+}
+
+std::vector<std::vector<Utils::Classification>> Utils::TopKBatch(span<const float> logits, size_t classes, const std::vector<std::string>& labels, size_t k, SoftmaxMode mode)
+{
+	if (classes == 0 || logits.size() % classes != 0)
+	{
+		throw std::invalid_argument("TopKBatch: the size of logits is not a multiple of classes");
+	}
+	std::vector<std::vector<Classification>> results;
+	results.reserve(logits.size() / classes);
+	for (size_t offset = 0; offset < logits.size(); offset += classes)
+	{
+		results.push_back(TopK(logits.subspan(offset, classes), labels, k, mode));
+	}
+	return results;
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "span.h"
+#include "Softmax.h"
+
+namespace Utils
+{
+	struct Classification
+	{
+		size_t ClassIndex = 0;
+		std::string Label;
+		float Probability = 0;
+	};
+
+	// the k highest logits (best first) with their probabilities, the logits are neither modified nor normalized:
+	// one pass selects the top k, one log-sum-exp reduction gives the probability of those k classes only
+	std::vector<Classification> TopK(span<const float> logits, const std::vector<std::string>& labels, size_t k, SoftmaxMode mode = SoftmaxMode::Exact);
+
+	// logits is a [batch, classes] matrix (e.g. the output of a batched run), one result per row
+	std::vector<std::vector<Classification>> TopKBatch(span<const float> logits, size_t classes, const std::vector<std::string>& labels, size_t k, SoftmaxMode mode = SoftmaxMode::Exact);
+}
@@ -0,0 +1,89 @@
+#include "CpuFeatures.h"
+#include <array>
+#include <cstdint>
+#ifdef _MSC_VER
+#include <intrin.h>
+#include <immintrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+static std::array<std::uint32_t, 4> CpuId(std::uint32_t leaf, std::uint32_t subleaf)
+{
+	std::array<std::uint32_t, 4> regs{};
+#ifdef _MSC_VER
+	int r[4];
+	__cpuidex(r, static_cast<int>(leaf), static_cast<int>(subleaf));
+	for (auto i = 0; i < 4; ++i)
+		regs[i] = static_cast<std::uint32_t>(r[i]);
+#else
+	__cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+	return regs;
+}
+
+static std::uint64_t ReadXcr0()
+{
+#ifdef _MSC_VER
+	return _xgetbv(0);
+#else
+	std::uint32_t eax, edx;
+	__asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+	return (static_cast<std::uint64_t>(edx) << 32) | eax;
+#endif
+}
+
+static Utils::CpuFeatures DetectCpuFeatures()
+{
+	Utils::CpuFeatures features;
+	const auto maxLeaf = CpuId(0, 0)[0];
+	if (maxLeaf < 1)
+		return features;
+
+	const auto leaf1 = CpuId(1, 0);
+	features.Sse41 = (leaf1[2] >> 19) & 1;
+	if (CpuId(0x80000000, 0)[0] >= 0x80000007)
+		features.InvariantTsc = (CpuId(0x80000007, 0)[3] >> 8) & 1;
+	const bool osxsave = (leaf1[2] >> 27) & 1;
+	if (!osxsave || maxLeaf < 7)
+		return features;
+
+	// the OS must save the YMM (and ZMM) state on context switches
+	const auto xcr0 = ReadXcr0();
+	const bool ymmEnabled = (xcr0 & 0x6) == 0x6;
+	const bool zmmEnabled = (xcr0 & 0xe6) == 0xe6;
+	const auto leaf7 = CpuId(7, 0);
+	const bool avx = (leaf1[2] >> 28) & 1;
+	features.Avx2 = ymmEnabled && avx && ((leaf7[1] >> 5) & 1);
+	features.Avx512 = zmmEnabled && features.Avx2 && ((leaf7[1] >> 16) & 1);
+	return features;
+}
+
+const Utils::CpuFeatures& Utils::GetCpuFeatures()
+{
+	static const auto features = DetectCpuFeatures();
+	return features;
+}
+
+Utils::SimdLevel Utils::BestSimdLevel()
+{
+	const auto& features = GetCpuFeatures();
+	if (features.Avx512)
+		return SimdLevel::Avx512;
+	if (features.Avx2)
+		return SimdLevel::Avx2;
+	if (features.Sse41)
+		return SimdLevel::Sse41;
+	return SimdLevel::Scalar;
+}
+
+const char* Utils::ToString(SimdLevel level)
+{
+	switch (level)
+	{
+	case SimdLevel::Sse41: return "SSE4.1";
+	case SimdLevel::Avx2: return "AVX2";
+	case SimdLevel::Avx512: return "AVX-512";
+	default: return "scalar";
+	}
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <cstdint>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// lets a single function use instructions the rest of the binary is not compiled for (MSVC needs nothing)
+#if defined(__GNUC__) || defined(__clang__)
+#define UTILS_TARGET(isa) __attribute__((target(isa)))
+#else
+#define UTILS_TARGET(isa)
+#endif
+
+namespace Utils
+{
+	struct CpuFeatures
+	{
+		bool Sse41 = false;
+		bool Avx2 = false;
+		bool Avx512 = false;
+		// the time stamp counter ticks at a constant rate whatever the frequency and power state of the core
+		bool InvariantTsc = false;
+	};
+
+	// queried once with CPUID (and XGETBV for the OS support of the wide registers)
+	const CpuFeatures& GetCpuFeatures();
+
+	enum class SimdLevel
+	{
+		Scalar,
+		Sse41,
+		Avx2,
+		Avx512,
+	};
+
+	SimdLevel BestSimdLevel();
+	const char* ToString(SimdLevel level);
+
+	// index of the lowest set bit, word must not be 0
+	inline std::uint32_t CountTrailingZeros(std::uint64_t word)
+	{
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanForward64(&index, word);
+		return index;
+#else
+		return static_cast<std::uint32_t>(__builtin_ctzll(word));
+#endif
+	}
+
+	// index of the highest set bit, word must not be 0
+	inline std::uint32_t HighestSetBit(std::uint64_t word)
+	{
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanReverse64(&index, word);
+		return index;
+#else
+		return 63 - static_cast<std::uint32_t>(__builtin_clzll(word));
+#endif
+	}
+}
@@ -0,0 +1,96 @@
+#include "Histogram.h"
+#include "CpuFeatures.h"
+#include <ostream>
+
+size_t Utils::Histogram::BucketOf(std::uint64_t value)
+{
+	if (value < SubBucketCount)
+		return static_cast<size_t>(value);
+	// the bits right below the highest one select the sub-bucket
+	const auto shift = HighestSetBit(value) - SubBucketBits;
+	return (shift + 1) * SubBucketCount + ((value >> shift) & (SubBucketCount - 1));
+}
+
+std::uint64_t Utils::Histogram::UpperBound(size_t bucket)
+{
+	if (bucket < SubBucketCount)
+		return bucket;
+	const auto shift = static_cast<std::uint32_t>(bucket / SubBucketCount - 1);
+	const auto subBucket = bucket % SubBucketCount;
+	if (shift == 64 - SubBucketBits - 1 && subBucket == SubBucketCount - 1)
+		return UINT64_MAX;
+	return ((SubBucketCount + subBucket + 1) << shift) - 1;
+}
+
+void Utils::Histogram::Record(std::uint64_t value)
+{
+	buckets[BucketOf(value)].fetch_add(1, std::memory_order_relaxed);
+}
+
+void Utils::Histogram::RecordUnshared(std::uint64_t value)
+{
+	auto& bucket = buckets[BucketOf(value)];
+	bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+void Utils::Histogram::Merge(const Histogram& other)
+{
+	for (size_t i = 0; i < BucketCount; ++i)
+	{
+		if (const auto count = other.buckets[i].load(std::memory_order_relaxed))
+			buckets[i].fetch_add(count, std::memory_order_relaxed);
+	}
+}
+
+void Utils::Histogram::Clear()
+{
+	for (auto& bucket : buckets)
+	{
+		bucket.store(0, std::memory_order_relaxed);
+	}
+}
+
+std::uint64_t Utils::Histogram::Count() const
+{
+	std::uint64_t count = 0;
+	for (const auto& bucket : buckets)
+	{
+		count += bucket.load(std::memory_order_relaxed);
+	}
+	return count;
+}
+
+std::uint64_t Utils::Histogram::Percentile(double percentile) const
+{
+	const auto total = Count();
+	if (total == 0)
+		return 0;
+	const auto target = static_cast<std::uint64_t>(total * percentile / 100.0);
+	std::uint64_t seen = 0;
+	for (size_t i = 0; i < BucketCount; ++i)
+	{
+		seen += buckets[i].load(std::memory_order_relaxed);
+		if (seen > target || seen == total)
+			return UpperBound(i);
+	}
+	return UpperBound(BucketCount - 1);
+}
+
+void Utils::Histogram::Print(std::ostream& os, const char* name, const char* unit) const
+{
+	os << name << " (" << Count() << " samples)\n";
+	// the fine buckets are folded back into powers of two to keep the listing short
+	std::uint64_t count = 0;
+	for (size_t i = 0; i < BucketCount; ++i)
+	{
+		count += buckets[i].load(std::memory_order_relaxed);
+		const auto upper = UpperBound(i);
+		const bool lastOfPower = upper == UINT64_MAX || ((upper + 1) & upper) == 0;
+		if (lastOfPower && count > 0)
+		{
+			os << "  <= " << upper << unit << ": " << count << "\n";
+			count = 0;
+		}
+	}
+	os << "  p50: " << Percentile(50) << unit << " p90: " << Percentile(90) << unit << " p99: " << Percentile(99) << unit << " p99.9: " << Percentile(99.9) << unit << "\n";
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <iosfwd>
+
+namespace Utils
+{
+	// log-linear buckets (HDR style): values below 32 are exact, above each power of two is split in 32 buckets,
+	// so a percentile is at most ~3% above the true value whatever the range. Cheap to record from one thread while others read
+	class Histogram
+	{
+	public:
+		void Record(std::uint64_t value);
+		// same as Record when only one thread ever records into this histogram: no locked instruction
+		void RecordUnshared(std::uint64_t value);
+		// adds the samples of other to this one
+		void Merge(const Histogram& other);
+		void Clear();
+
+		std::uint64_t Count() const;
+		// upper bound of the bucket containing the given percentile (0-100)
+		std::uint64_t Percentile(double percentile) const;
+		// samples per power of two, then p50/p90/p99/p99.9
+		void Print(std::ostream& os, const char* name, const char* unit) const;
+
+	private:
+		static constexpr std::uint32_t SubBucketBits = 5;
+		static constexpr std::uint32_t SubBucketCount = 1 << SubBucketBits;
+		static constexpr size_t BucketCount = SubBucketCount * (64 - SubBucketBits + 1);
+
+		static size_t BucketOf(std::uint64_t value);
+		static std::uint64_t UpperBound(size_t bucket);
+
+		std::array<std::atomic<std::uint64_t>, BucketCount> buckets{};
+	};
+}
@@ -0,0 +1,145 @@
+#include "Instrumentation.h"
+#include "CpuFeatures.h"
+#include "Tracing.h"
+#include <iomanip>
+#include <ostream>
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+
+static const bool UseTsc = Utils::GetCpuFeatures().InvariantTsc;
+
+const char* Utils::ToString(Stage stage)
+{
+	switch (stage)
+	{
+	case Stage::Decode: return "decode";
+	case Stage::Preprocess: return "preprocess";
+	case Stage::Run: return "run";
+	case Stage::Postprocess: return "postprocess";
+	case Stage::Draw: return "draw";
+	case Stage::Encode: return "encode";
+	default: return "unknown";
+	}
+}
+
+std::uint64_t Utils::ReadTicks()
+{
+	if (UseTsc)
+		return __rdtsc();
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+double Utils::MicrosecondsPerTick(std::uint64_t startTicks, std::chrono::steady_clock::time_point startTime)
+{
+	if (!UseTsc)
+		return 1e-3;
+	const auto microseconds = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - startTime).count();
+	const auto ticks = ReadTicks() - startTicks;
+	return ticks ? microseconds / ticks : 0.0;
+}
+
+Utils::StageProfiler& Utils::StageProfiler::Instance()
+{
+	static StageProfiler profiler;
+	return profiler;
+}
+
+Utils::StageProfiler::StageProfiler()
+{
+	Reset();
+}
+
+// returns the set of the thread to the profiler when the thread exits
+struct Utils::StageProfiler::ThreadExit
+{
+	ThreadHistograms& Histograms;
+
+	~ThreadExit()
+	{
+		StageProfiler::Instance().Release(Histograms);
+	}
+};
+
+Utils::StageProfiler::ThreadHistograms& Utils::StageProfiler::Acquire()
+{
+	std::lock_guard lock{ mutex };
+	if (!released.empty())
+	{
+		auto& histograms = *released.back();
+		released.pop_back();
+		return histograms;
+	}
+	threads.push_back(std::make_unique<ThreadHistograms>());
+	return *threads.back();
+}
+
+void Utils::StageProfiler::Release(ThreadHistograms& histograms)
+{
+	std::lock_guard lock{ mutex };
+	released.push_back(&histograms);
+}
+
+void Utils::StageProfiler::Record(Stage stage, std::uint64_t ticks)
+{
+	// the only lock is taken once per thread
+	thread_local ThreadHistograms* histograms = nullptr;
+	if (!histograms)
+	{
+		histograms = &Acquire();
+		thread_local const ThreadExit exit{ *histograms };
+	}
+	histograms->Stages[static_cast<size_t>(stage)].RecordUnshared(ticks);
+}
+
+void Utils::StageProfiler::Reset()
+{
+	std::lock_guard lock{ mutex };
+	for (auto& thread : threads)
+	{
+		for (auto& histogram : thread->Stages)
+			histogram.Clear();
+	}
+	startTime = std::chrono::steady_clock::now();
+	startTicks = ReadTicks();
+}
+
+void Utils::StageProfiler::Print(std::ostream& os) const
+{
+	std::lock_guard lock{ mutex };
+	const auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+	// the TSC is calibrated against steady_clock over the whole run
+	const auto microsecondsPerTick = MicrosecondsPerTick(startTicks, startTime);
+
+	os << std::left << std::setw(12) << "stage" << std::right << std::setw(8) << "samples"
+		<< std::setw(11) << "p50 us" << std::setw(11) << "p90 us" << std::setw(11) << "p99 us" << std::setw(11) << "p99.9 us" << std::setw(11) << "per second" << "\n";
+	const auto flags = os.flags();
+	const auto precision = os.precision();
+	os << std::fixed << std::setprecision(1);
+	for (size_t stage = 0; stage < StageCount; ++stage)
+	{
+		Histogram merged;
+		for (const auto& thread : threads)
+			merged.Merge(thread->Stages[stage]);
+		const auto count = merged.Count();
+		if (count == 0)
+			continue;
+		os << std::left << std::setw(12) << ToString(static_cast<Stage>(stage)) << std::right << std::setw(8) << count;
+		for (const auto percentile : { 50.0, 90.0, 99.0, 99.9 })
+			os << std::setw(11) << merged.Percentile(percentile) * microsecondsPerTick;
+		os << std::setw(11) << (seconds > 0 ? count / seconds : 0.0) << "\n";
+	}
+	os.flags(flags);
+	os.precision(precision);
+	os << "wall time: " << seconds << " s\n";
+}
+
+Utils::ScopeTimer::~ScopeTimer()
+{
+	const auto end = ReadTicks();
+	StageProfiler::Instance().Record(stage, end - start);
+	if (Tracer::Enabled())
+		Tracer::Instance().Record(stage, start, end);
+}
@@ -0,0 +1,87 @@
+#pragma once
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "Histogram.h"
+
+namespace Utils
+{
+	// where the time of a frame goes
+	enum class Stage
+	{
+		Decode,
+		Preprocess,
+		Run,
+		Postprocess,
+		Draw,
+		Encode,
+	};
+
+	constexpr size_t StageCount = 6;
+
+	const char* ToString(Stage stage);
+
+	// the time stamp counter when it's invariant (a few ns to read), steady_clock otherwise
+	std::uint64_t ReadTicks();
+	// length of a tick in microseconds, measured against steady_clock since a pair of reference points taken together
+	double MicrosecondsPerTick(std::uint64_t startTicks, std::chrono::steady_clock::time_point startTime);
+
+	// latency histograms of every stage, one set per thread: recording never touches memory shared with other threads
+	class StageProfiler
+	{
+	public:
+		static StageProfiler& Instance();
+
+		// ticks are the difference of two ReadTicks
+		void Record(Stage stage, std::uint64_t ticks);
+
+		// forgets the samples recorded so far and restarts the clock of the throughput
+		void Reset();
+		// merges the threads, then one line per stage with samples: p50/p90/p99/p99.9 and samples per second since Reset
+		void Print(std::ostream& os) const;
+
+	private:
+		StageProfiler();
+
+		struct ThreadHistograms
+		{
+			std::array<Histogram, StageCount> Stages;
+		};
+		struct ThreadExit;
+
+		ThreadHistograms& Acquire();
+		void Release(ThreadHistograms& histograms);
+
+		mutable std::mutex mutex;
+		// the histograms outlive their threads: the samples of the workers of a pipeline are still there at the end of the run.
+		// A thread that exits hands its set, samples included, to the next thread that records: there are never more sets
+		// than threads recording at the same time
+		std::vector<std::unique_ptr<ThreadHistograms>> threads;
+		std::vector<ThreadHistograms*> released;
+		std::chrono::steady_clock::time_point startTime;
+		std::uint64_t startTicks = 0;
+	};
+
+	// records the lifetime of the scope into the histogram of the stage, and into the timeline when tracing
+	class ScopeTimer
+	{
+	public:
+		explicit ScopeTimer(Stage stage)
+			: stage(stage), start(ReadTicks())
+		{
+		}
+
+		~ScopeTimer();
+
+		ScopeTimer(const ScopeTimer&) = delete;
+		ScopeTimer& operator=(const ScopeTimer&) = delete;
+
+	private:
+		Stage stage;
+		std::uint64_t start;
+	};
+}
@@ -0,0 +1,369 @@
+#include "Json.h"
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+
+const Utils::JsonValue* Utils::JsonValue::Find(std::string_view key) const
+{
+	if (const auto* object = std::get_if<Object>(&Value))
+	{
+		for (const auto& [name, value] : *object)
+		{
+			if (name == key)
+				return &value;
+		}
+	}
+	return nullptr;
+}
+
+Utils::JsonValue* Utils::JsonValue::Find(std::string_view key)
+{
+	return const_cast<JsonValue*>(std::as_const(*this).Find(key));
+}
+
+double Utils::JsonValue::Number(double fallback) const
+{
+	const auto* number = std::get_if<double>(&Value);
+	return number ? *number : fallback;
+}
+
+const std::string& Utils::JsonValue::String() const
+{
+	static const std::string empty;
+	const auto* text = std::get_if<std::string>(&Value);
+	return text ? *text : empty;
+}
+
+const Utils::JsonValue::Array& Utils::JsonValue::Elements() const
+{
+	static const Array empty;
+	const auto* elements = std::get_if<Array>(&Value);
+	return elements ? *elements : empty;
+}
+
+namespace
+{
+	class JsonParser
+	{
+	public:
+		explicit JsonParser(std::string_view text)
+			: text(text)
+		{
+		}
+
+		Utils::JsonValue ParseDocument()
+		{
+			auto value = ParseValue();
+			SkipWhitespace();
+			if (position != text.size())
+				Fail("trailing characters");
+			return value;
+		}
+
+	private:
+		[[noreturn]] void Fail(const char* what) const
+		{
+			throw std::runtime_error(std::string{ "invalid JSON at offset " } + std::to_string(position) + ": " + what);
+		}
+
+		void SkipWhitespace()
+		{
+			while (position < text.size() && (text[position] == ' ' || text[position] == '\t' || text[position] == '\n' || text[position] == '\r'))
+				++position;
+		}
+
+		char Peek()
+		{
+			SkipWhitespace();
+			if (position == text.size())
+				Fail("unexpected end");
+			return text[position];
+		}
+
+		void Expect(char c)
+		{
+			if (Peek() != c)
+				Fail("unexpected character");
+			++position;
+		}
+
+		bool Consume(std::string_view word)
+		{
+			if (text.substr(position, word.size()) != word)
+				return false;
+			position += word.size();
+			return true;
+		}
+
+		Utils::JsonValue ParseValue()
+		{
+			switch (Peek())
+			{
+			case '{': return { ParseObject() };
+			case '[': return { ParseArray() };
+			case '"': return { ParseString() };
+			case 't': if (Consume("true")) return { true }; break;
+			case 'f': if (Consume("false")) return { false }; break;
+			case 'n': if (Consume("null")) return { nullptr }; break;
+			default: return { ParseNumber() };
+			}
+			Fail("unknown literal");
+		}
+
+		Utils::JsonValue::Object ParseObject()
+		{
+			Expect('{');
+			Utils::JsonValue::Object object;
+			if (Peek() == '}')
+			{
+				++position;
+				return object;
+			}
+			while (true)
+			{
+				if (Peek() != '"')
+					Fail("expected a member name");
+				auto name = ParseString();
+				Expect(':');
+				object.emplace_back(std::move(name), ParseValue());
+				if (Peek() == '}')
+				{
+					++position;
+					return object;
+				}
+				Expect(',');
+			}
+		}
+
+		Utils::JsonValue::Array ParseArray()
+		{
+			Expect('[');
+			Utils::JsonValue::Array array;
+			if (Peek() == ']')
+			{
+				++position;
+				return array;
+			}
+			while (true)
+			{
+				array.push_back(ParseValue());
+				if (Peek() == ']')
+				{
+					++position;
+					return array;
+				}
+				Expect(',');
+			}
+		}
+
+		std::uint32_t ParseHex4()
+		{
+			if (position + 4 > text.size())
+				Fail("truncated escape");
+			std::uint32_t code = 0;
+			for (auto i = 0; i < 4; ++i)
+			{
+				const auto c = text[position++];
+				code <<= 4;
+				if (c >= '0' && c <= '9')
+					code |= c - '0';
+				else if (c >= 'a' && c <= 'f')
+					code |= c - 'a' + 10;
+				else if (c >= 'A' && c <= 'F')
+					code |= c - 'A' + 10;
+				else
+					Fail("invalid escape");
+			}
+			return code;
+		}
+
+		static void AppendUtf8(std::string& out, std::uint32_t code)
+		{
+			if (code < 0x80)
+			{
+				out += static_cast<char>(code);
+			}
+			else if (code < 0x800)
+			{
+				out += static_cast<char>(0xc0 | (code >> 6));
+				out += static_cast<char>(0x80 | (code & 0x3f));
+			}
+			else if (code < 0x10000)
+			{
+				out += static_cast<char>(0xe0 | (code >> 12));
+				out += static_cast<char>(0x80 | ((code >> 6) & 0x3f));
+				out += static_cast<char>(0x80 | (code & 0x3f));
+			}
+			else
+			{
+				out += static_cast<char>(0xf0 | (code >> 18));
+				out += static_cast<char>(0x80 | ((code >> 12) & 0x3f));
+				out += static_cast<char>(0x80 | ((code >> 6) & 0x3f));
+				out += static_cast<char>(0x80 | (code & 0x3f));
+			}
+		}
+
+		std::string ParseString()
+		{
+			Expect('"');
+			std::string out;
+			while (true)
+			{
+				if (position == text.size())
+					Fail("unterminated string");
+				const auto c = text[position++];
+				if (c == '"')
+					return out;
+				if (c != '\\')
+				{
+					out += c;
+					continue;
+				}
+				if (position == text.size())
+					Fail("unterminated string");
+				switch (text[position++])
+				{
+				case '"': out += '"'; break;
+				case '\\': out += '\\'; break;
+				case '/': out += '/'; break;
+				case 'b': out += '\b'; break;
+				case 'f': out += '\f'; break;
+				case 'n': out += '\n'; break;
+				case 'r': out += '\r'; break;
+				case 't': out += '\t'; break;
+				case 'u':
+				{
+					auto code = ParseHex4();
+					// a surrogate pair encodes one code point above the basic plane
+					if (code >= 0xd800 && code < 0xdc00 && Consume("\\u"))
+						code = 0x10000 + ((code - 0xd800) << 10) + (ParseHex4() - 0xdc00);
+					AppendUtf8(out, code);
+					break;
+				}
+				default: Fail("invalid escape");
+				}
+			}
+		}
+
+		double ParseNumber()
+		{
+			const auto begin = position;
+			while (position < text.size() && std::string_view{ "+-0123456789.eE" }.find(text[position]) != std::string_view::npos)
+				++position;
+			if (position == begin)
+				Fail("unexpected character");
+			const std::string token{ text.substr(begin, position - begin) };
+			char* end = nullptr;
+			const auto number = std::strtod(token.c_str(), &end);
+			if (end != token.c_str() + token.size())
+				Fail("invalid number");
+			return number;
+		}
+
+		std::string_view text;
+		size_t position = 0;
+	};
+}
+
+Utils::JsonValue Utils::ParseJson(std::string_view text)
+{
+	return JsonParser{ text }.ParseDocument();
+}
+
+Utils::JsonValue Utils::ReadJsonFile(const std::filesystem::path& path)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+	{
+		throw std::runtime_error("cannot open " + path.string());
+	}
+	std::ostringstream content;
+	content << file.rdbuf();
+	return ParseJson(content.str());
+}
+
+void Utils::WriteJsonString(std::ostream& os, std::string_view text)
+{
+	os << '"';
+	for (const auto c : text)
+	{
+		switch (c)
+		{
+		case '"': os << "\\\""; break;
+		case '\\': os << "\\\\"; break;
+		case '\n': os << "\\n"; break;
+		case '\r': os << "\\r"; break;
+		case '\t': os << "\\t"; break;
+		default:
+			if (static_cast<unsigned char>(c) < 0x20)
+				os << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(c) << std::dec << std::setfill(' ');
+			else
+				os << c;
+		}
+	}
+	os << '"';
+}
+
+void Utils::WriteJson(std::ostream& os, const JsonValue& value)
+{
+	std::visit([&](const auto& v) {
+		using T = std::decay_t<decltype(v)>;
+		if constexpr (std::is_same_v<T, std::nullptr_t>)
+		{
+			os << "null";
+		}
+		else if constexpr (std::is_same_v<T, bool>)
+		{
+			os << (v ? "true" : "false");
+		}
+		else if constexpr (std::is_same_v<T, double>)
+		{
+			if (!std::isfinite(v))
+				os << "null";
+			else if (v == std::floor(v) && std::abs(v) < 9007199254740992.0)
+				os << static_cast<long long>(v);
+			else
+			{
+				// whatever the format of the stream: its flags are restored after
+				const auto flags = os.flags();
+				const auto precision = os.precision(17);
+				os << std::defaultfloat << v;
+				os.flags(flags);
+				os.precision(precision);
+			}
+		}
+		else if constexpr (std::is_same_v<T, std::string>)
+		{
+			WriteJsonString(os, v);
+		}
+		else if constexpr (std::is_same_v<T, JsonValue::Array>)
+		{
+			os << '[';
+			for (size_t i = 0; i < v.size(); ++i)
+			{
+				if (i > 0)
+					os << ',';
+				WriteJson(os, v[i]);
+			}
+			os << ']';
+		}
+		else
+		{
+			os << '{';
+			for (size_t i = 0; i < v.size(); ++i)
+			{
+				if (i > 0)
+					os << ',';
+				WriteJsonString(os, v[i].first);
+				os << ':';
+				WriteJson(os, v[i].second);
+			}
+			os << '}';
+		}
+	}, value.Value);
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include <filesystem>
+#include <iosfwd>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace Utils
+{
+	// just enough JSON for the profiles of ORT and the traces we write: members keep their order, numbers are doubles
+	struct JsonValue
+	{
+		using Array = std::vector<JsonValue>;
+		using Object = std::vector<std::pair<std::string, JsonValue>>;
+
+		std::variant<std::nullptr_t, bool, double, std::string, Array, Object> Value;
+
+		// member of an object, null when missing or when this is not an object
+		const JsonValue* Find(std::string_view key) const;
+		JsonValue* Find(std::string_view key);
+
+		// the value or the fallback when it has another type
+		double Number(double fallback = 0) const;
+		const std::string& String() const;
+		const Array& Elements() const;
+	};
+
+	// throws std::runtime_error with the offset of the first malformed character
+	JsonValue ParseJson(std::string_view text);
+	JsonValue ReadJsonFile(const std::filesystem::path& path);
+	// compact, integers below 2^53 are written without exponent nor decimals
+	void WriteJson(std::ostream& os, const JsonValue& value);
+	void WriteJsonString(std::ostream& os, std::string_view text);
+}
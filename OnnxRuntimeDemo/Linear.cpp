@@ -1,5 +1,6 @@
 #include "Linear.h"
 #include <onnxruntime_cxx_api.h>
+#include "ModelRegistry.h"
 #include <array>
 #include <iostream>
 
@@ -7,31 +8,22 @@ using namespace std;
 
 void Demo::RunLinearRegression()
 {
-	// gives access to the underlying API (you can optionally customize log)
-	// you can create one environment per process (each environment manages an internal thread pool)
-	Ort::Env env;
+	// the registry owns the (only) environment of the process and gives access to the underlying API
+	// the session is created (and the model parsed) only the first time we ask for it
+	auto& model = Utils::ModelRegistry::Instance().Get(LR"(data\linear.onnx)");
 
-	// creates an inference session for a certain model
-	Ort::Session session{ env, LR"(data\linear.onnx)", Ort::SessionOptions{} };
-
-	// Ort::Session gives access to input and output information:
+	// Utils::Model caches input and output information:
 	// - count
 	// - name
 	// - shape and type
-	std::cout << "Number of model inputs: " << session.GetInputCount() << "\n";
-	std::cout << "Number of model outputs: " << session.GetOutputCount() << "\n";
-
-	// you can customize how allocation works. Let's just use a default allocator provided by the library
-	Ort::AllocatorWithDefaultOptions allocator;
-	// get input and output names
-	auto* inputName = session.GetInputName(0, allocator);
-	std::cout << "Input name: " << inputName << "\n";
+	std::cout << "Number of model inputs: " << model.Inputs.size() << "\n";
+	std::cout << "Number of model outputs: " << model.Outputs.size() << "\n";
 
-	auto* outputName = session.GetOutputName(0, allocator);
-	std::cout << "Output name: " << outputName << "\n";
+	std::cout << "Input name: " << model.Inputs[0].Name << "\n";
+	std::cout << "Output name: " << model.Outputs[0].Name << "\n";
 
 	// get input shape
-	auto inputShape = session.GetInputTypeInfo(0).GetTensorTypeAndShapeInfo().GetShape();
+	const auto& inputShape = model.Inputs[0].Shape;
 	// set some input values
 	std::vector<float> inputValues = { 4, 5, 6 };
 
@@ -43,15 +35,10 @@ void Demo::RunLinearRegression()
 		inputValues.data(), inputValues.size(), 
 		inputShape.data(), inputShape.size());
 
-	// the API needs the array of inputs you set and the array of outputs you get
-	array inputNames = { inputName };
-	array outputNames = { outputName };
-
-	// finally run the inference!
-	auto outputValues = session.Run(
-		Ort::RunOptions{ nullptr }, // e.g. set a verbosity level only for this run
-		inputNames.data(), &inputOnnxTensor, 1, // input to set
-		outputNames.data(), 1);					// output to take 
+	// finally run the inference! (the model passes the cached arrays of input and output names)
+	auto outputValues = model.Run(
+		&inputOnnxTensor, 1,		// input to set
+		Ort::RunOptions{ nullptr });	// e.g. set a verbosity level only for this run
 
 	// extract first (and only) output
 	auto& output1 = outputValues[0];
@@ -60,9 +47,4 @@ void Demo::RunLinearRegression()
 
 	// just print the output values
 	std::copy_n(floats, floatsCount, ostream_iterator<float>(cout, " "));
-
-
-	// closing boilerplate
-	allocator.Free(inputName);
-	allocator.Free(outputName);
 }
@@ -0,0 +1,153 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include "Histogram.h"
+
+namespace Utils
+{
+	// coalesces concurrent single requests into batches of up to maxBatch elements
+	// a batch is dispatched as soon as it is full or when its oldest request has waited for deadline
+	template<typename Request, typename Result>
+	class MicroBatcher
+	{
+	public:
+		// must return one result per request, in the same order
+		using BatchFunction = std::function<std::vector<Result>(std::vector<Request>&)>;
+
+		// maxBatch must be at least 1
+		MicroBatcher(BatchFunction batchFunction, size_t maxBatch, std::chrono::microseconds deadline)
+			: batchFunction(std::move(batchFunction)), maxBatch(CheckedMaxBatch(maxBatch)), deadline(deadline), worker([this] { Loop(); })
+		{
+		}
+
+		MicroBatcher(const MicroBatcher&) = delete;
+		MicroBatcher& operator=(const MicroBatcher&) = delete;
+
+		// pending requests are still served
+		~MicroBatcher()
+		{
+			{
+				std::lock_guard lock{ mutex };
+				stopping = true;
+			}
+			wakeUp.notify_one();
+			worker.join();
+		}
+
+		std::future<Result> Submit(Request request)
+		{
+			std::promise<Result> promise;
+			auto future = promise.get_future();
+			{
+				std::lock_guard lock{ mutex };
+				queue.push_back({ std::move(request), std::move(promise), std::chrono::steady_clock::now() });
+			}
+			wakeUp.notify_one();
+			return future;
+		}
+
+		const Histogram& BatchSizes() const
+		{
+			return batchSizes;
+		}
+
+		// microseconds spent by each request in the queue before its batch is dispatched
+		const Histogram& QueueWaits() const
+		{
+			return queueWaits;
+		}
+
+	private:
+		struct Pending
+		{
+			Request request;
+			std::promise<Result> promise;
+			std::chrono::steady_clock::time_point enqueued;
+		};
+
+		// before the worker starts: an empty batch would never take a request out of the queue
+		static size_t CheckedMaxBatch(size_t maxBatch)
+		{
+			if (maxBatch == 0)
+				throw std::invalid_argument("MicroBatcher: maxBatch must be at least 1");
+			return maxBatch;
+		}
+
+		void Loop()
+		{
+			std::vector<Pending> batch;
+			std::vector<Request> requests;
+			while (true)
+			{
+				{
+					std::unique_lock lock{ mutex };
+					wakeUp.wait(lock, [this] { return stopping || !queue.empty(); });
+					if (queue.empty())
+						return;
+					wakeUp.wait_until(lock, queue.front().enqueued + deadline, [this] { return stopping || queue.size() >= maxBatch; });
+					
+					const auto count = std::min(queue.size(), maxBatch);
+					for (size_t i = 0; i < count; ++i)
+					{
+						batch.push_back(std::move(queue.front()));
+						queue.pop_front();
+					}
+				}
+
+				Dispatch(batch, requests);
+				batch.clear();
+				requests.clear();
+			}
+		}
+
+		void Dispatch(std::vector<Pending>& batch, std::vector<Request>& requests)
+		{
+			const auto now = std::chrono::steady_clock::now();
+			batchSizes.Record(batch.size());
+			for (auto& pending : batch)
+			{
+				queueWaits.Record(std::chrono::duration_cast<std::chrono::microseconds>(now - pending.enqueued).count());
+				requests.push_back(std::move(pending.request));
+			}
+
+			try
+			{
+				auto results = batchFunction(requests);
+				if (results.size() != batch.size())
+					throw std::logic_error("batch function must return one result per request");
+				for (size_t i = 0; i < batch.size(); ++i)
+				{
+					batch[i].promise.set_value(std::move(results[i]));
+				}
+			}
+			catch (...)
+			{
+				for (auto& pending : batch)
+				{
+					pending.promise.set_exception(std::current_exception());
+				}
+			}
+		}
+
+		BatchFunction batchFunction;
+		size_t maxBatch;
+		std::chrono::microseconds deadline;
+		
+		std::mutex mutex;
+		std::condition_variable wakeUp;
+		std::deque<Pending> queue;
+		bool stopping = false;
+		
+		Histogram batchSizes;
+		Histogram queueWaits;
+
+		std::thread worker;
+	};
+}
@@ -1,13 +1,26 @@
 ﻿#include "MobileNet.h"
+#include <algorithm>
 #include <iostream>
 #include <filesystem>
+#include <chrono>
+#include <limits>
+#include <optional>
+#include <string>
 #include <onnxruntime_cxx_api.h>
 #include "Box.h"
 #include "span.h"
 #include "Utils.h"
 #include "DrawingUtils.h"
-#include <xtensor/xarray.hpp>
-#include <xtensor/xadapt.hpp>
+#include "ModelRegistry.h"
+#include "SteadyStateSession.h"
+#include "Pipeline.h"
+#include "Preprocessing.h"
+#include "WritableTensor.h"
+#include "Softmax.h"
+#include "SsdPriors.h"
+#include "Nms.h"
+#include "ThreadPool.h"
+#include "Instrumentation.h"
 
 using namespace std;
 using namespace Utils;
@@ -17,300 +30,425 @@ using namespace Utils;
 // (part of the tkDNN library)
 
 static const size_t N_COORDS = 4;
-static const size_t N_SSDSPEC = 6;
 static const float centerVariance = 0.1f;
 static const float sizeVariance = 0.2f;
 
-struct SSDSpec
+std::array<float, N_COORDS> MobileNet::DecodeBox(const float* location, const SsdPriorsView& priors, std::uint32_t j)
 {
-	int featureSize = 0;
-	int shrinkage = 0;
-	int boxWidth = 0;
-	int boxHeight = 0;
-	int ratio1 = 0;
-	int ratio2 = 0;
-
-	void setAll(int feature_size, int shrinkage, int box_width, int box_height, int ratio1, int ratio2)
-	{
-		this->featureSize = feature_size;
-		this->shrinkage = shrinkage;
-		this->boxWidth = box_width;
-		this->boxHeight = box_height;
-		this->ratio1 = ratio1;
-		this->ratio2 = ratio2;
-	}
-};
+	const auto x = location[0] * centerVariance * priors.W[j] + priors.X[j];
+	const auto y = location[1] * centerVariance * priors.H[j] + priors.Y[j];
+	const auto w = exp(location[2] * sizeVariance) * priors.W[j];
+	const auto h = exp(location[3] * sizeVariance) * priors.H[j];
+	return { x - w / 2, y - h / 2, x + w / 2, y + h / 2 };
+}
 
-std::vector<float> GenerateSDDPriors(const std::array<SSDSpec, N_SSDSPEC>& specs, float imageSize)
+// the network together with the priors its box offsets refer to: the head of the demo uses the table computed at
+// compile time, any other head gets priors generated when the object is built and owned by it
+class MobileNetModel
 {
-	const auto nPriors = std::accumulate(begin(specs), end(specs), 0, [](auto curr, const auto& spec) {
-		return curr + spec.featureSize * spec.featureSize * 6;
-	});
-	
-	std::vector<float> priors(N_COORDS * nPriors);
-
-	int i_prio = 0;
-	float w;
-	for (int i = 0; i < N_SSDSPEC; i++)
+public:
+	explicit MobileNetModel(Model& network, span<const SsdSpec> specs = MobileNetSsdSpecs, float imageSize = MobileNetSsdImageSize)
+		: Network(network)
 	{
-		const float scale = imageSize / (float)specs[i].shrinkage;
-		const int min = specs[i].boxHeight > specs[i].boxWidth ? specs[i].boxWidth : specs[i].boxHeight;
-		const int max = specs[i].boxHeight < specs[i].boxWidth ? specs[i].boxWidth : specs[i].boxHeight;
-		for (int j = 0; j < specs[i].featureSize; j++) 
+		if (std::equal(begin(specs), end(specs), begin(MobileNetSsdSpecs), end(MobileNetSsdSpecs)) && imageSize == MobileNetSsdImageSize)
 		{
-			for (int k = 0; k < specs[i].featureSize; k++) 
-			{
-				//small sized square box
-				const float x_center = (k + 0.5f) / scale;
-				const float y_center = (j + 0.5f) / scale;
-				float h = w = min / imageSize;
-
-				priors[i_prio * N_COORDS + 0] = x_center;
-				priors[i_prio * N_COORDS + 1] = y_center;
-				priors[i_prio * N_COORDS + 2] = w;
-				priors[i_prio * N_COORDS + 3] = h;
-				++i_prio;
-
-				//big sized square box
-				h = w = sqrtf(static_cast<float>(max) * min) / imageSize;
-
-				priors[i_prio * N_COORDS + 0] = x_center;
-				priors[i_prio * N_COORDS + 1] = y_center;
-				priors[i_prio * N_COORDS + 2] = w;
-				priors[i_prio * N_COORDS + 3] = h;
-				++i_prio;
-
-				//change h/w ratio of the small sized box
-				h = w = min / imageSize;
-				float ratio = sqrtf(static_cast<float>(specs[i].ratio1));
-				priors[i_prio * N_COORDS + 0] = x_center;
-				priors[i_prio * N_COORDS + 1] = y_center;
-				priors[i_prio * N_COORDS + 2] = w * ratio;
-				priors[i_prio * N_COORDS + 3] = h / ratio;
-				++i_prio;
-
-				priors[i_prio * N_COORDS + 0] = x_center;
-				priors[i_prio * N_COORDS + 1] = y_center;
-				priors[i_prio * N_COORDS + 2] = w / ratio;
-				priors[i_prio * N_COORDS + 3] = h * ratio;
-				++i_prio;
-
-				ratio = sqrtf(static_cast<float>(specs[i].ratio2));
-				priors[i_prio * N_COORDS + 0] = x_center;
-				priors[i_prio * N_COORDS + 1] = y_center;
-				priors[i_prio * N_COORDS + 2] = w * ratio;
-				priors[i_prio * N_COORDS + 3] = h / ratio;
-				++i_prio;
-
-				priors[i_prio * N_COORDS + 0] = x_center;
-				priors[i_prio * N_COORDS + 1] = y_center;
-				priors[i_prio * N_COORDS + 2] = w / ratio;
-				priors[i_prio * N_COORDS + 3] = h * ratio;
-				++i_prio;
-			}
+			Priors = MobileNetSsdPriors();
+		}
+		else
+		{
+			generated.emplace(specs, imageSize);
+			Priors = generated->View();
+		}
+
+		const auto boxes = Network.Outputs[1].Shape[1];
+		if (boxes > 0 && static_cast<size_t>(boxes) != Priors.Size())
+		{
+			throw std::runtime_error("MobileNetModel: the network outputs " + std::to_string(boxes) + " boxes for " + std::to_string(Priors.Size()) + " priors");
 		}
 	}
+	MobileNetModel(const MobileNetModel&) = delete;
+	MobileNetModel& operator=(const MobileNetModel&) = delete;
 
-	std::transform(begin(priors), end(priors), begin(priors), [](auto prior) {
-		return std::clamp(prior, 0.0f, 1.0f);
-	});
+	Model& Network;
+	SsdPriorsView Priors;
 
-	return priors;
-}
+private:
+	std::optional<SsdPriors> generated;
+};
 
-void ConvertLocationsToBoxesAndCenter(size_t nPriors, span<float> locations_h, span<const float> priors)
+// shared by the ParallelPerClass engines of all the threads: each Run waits only for its own classes
+static ThreadPool& NmsPool()
 {
-	for (auto i = 0u; i < nPriors; i++)
-	{
-		locations_h[i * N_COORDS + 0] = locations_h[i * N_COORDS + 0] * centerVariance * priors[i * N_COORDS + 2] + priors[i * N_COORDS + 0];
-		locations_h[i * N_COORDS + 1] = locations_h[i * N_COORDS + 1] * centerVariance * priors[i * N_COORDS + 3] + priors[i * N_COORDS + 1];
-		locations_h[i * N_COORDS + 2] = exp(locations_h[i * N_COORDS + 2] * sizeVariance) * priors[i * N_COORDS + 2];
-		locations_h[i * N_COORDS + 3] = exp(locations_h[i * N_COORDS + 3] * sizeVariance) * priors[i * N_COORDS + 3];
-
-		const auto cur_x = locations_h[i * N_COORDS + 0];
-		const auto cur_y = locations_h[i * N_COORDS + 1];
-
-		locations_h[i * N_COORDS + 0] = cur_x - locations_h[i * N_COORDS + 2] / 2;
-		locations_h[i * N_COORDS + 1] = cur_y - locations_h[i * N_COORDS + 3] / 2;
-		locations_h[i * N_COORDS + 2] = cur_x + locations_h[i * N_COORDS + 2] / 2;
-		locations_h[i * N_COORDS + 3] = cur_y + locations_h[i * N_COORDS + 3] / 2;
-	}
+	static ThreadPool pool;
+	return pool;
 }
 
-std::vector<float> priors;
-
-void InitPriors()
+// one suppression engine per thread and mode, its buffers are reused from one frame to the next
+static MultiClassNms& ThreadNms(NmsMode mode)
 {
-	static const float imageSize = 512;
-	std::array<SSDSpec, N_SSDSPEC> specs{};
-	specs[0].setAll(32, 16, 60, 105, 2, 3);
-	specs[1].setAll(16, 32, 105, 150, 2, 3);
-	specs[2].setAll(8, 64, 150, 195, 2, 3);
-	specs[3].setAll(4, 100, 195, 240, 2, 3);
-	specs[4].setAll(2, 150, 240, 285, 2, 3);
-	specs[5].setAll(1, 300, 285, 330, 2, 3);
-	priors = GenerateSDDPriors(specs, imageSize);
+	switch (mode)
+	{
+	case NmsMode::Batched:
+	{
+		thread_local MultiClassNms nms{ NmsMode::Batched };
+		return nms;
+	}
+	case NmsMode::ParallelPerClass:
+	{
+		thread_local MultiClassNms nms{ NmsMode::ParallelPerClass, &NmsPool() };
+		return nms;
+	}
+	default:
+	{
+		thread_local MultiClassNms nms{ NmsMode::PerClass };
+		return nms;
+	}
+	}
 }
 
-std::vector<Box> MobileNetPostprocess(span<float> confidences_h, span<float> locations_h, int classes, cv::Size originalSize, float confThreshold)
+static std::vector<Box> MobileNetPostprocess(const std::vector<RowProbability>& selected, span<const float> locations_h, const SsdPriorsView& priors, size_t classes, cv::Size originalSize, const NmsOptions& nmsOptions)
 {
-	const auto nPriors = priors.size() / 4u;
-
-	ConvertLocationsToBoxesAndCenter(nPriors, locations_h, priors);
-
 	const int width = originalSize.width;
 	const int height = originalSize.height;
 	const float IoUThreshold = 0.45f;
 
-	std::vector<Box> detected;
+	auto& nms = ThreadNms(nmsOptions.Mode);
+	nms.Clear(classes);
 
-	for (int i = 1; i < classes; i++) 
+	// only the few (prior, class) pairs above the threshold get their box decoded
+	// (the outputs are only read and can be used again)
+	auto decoded = std::numeric_limits<std::uint32_t>::max();
+	std::array<float, N_COORDS> box{};
+	for (const auto [j, cl, probability] : selected)
 	{
-		const auto conf_per_class = &confidences_h[i * nPriors];
-		std::vector<Box> boxes;
-		for (int j = 0; j < nPriors; j++) 
+		// the classes of a prior are adjacent: decode each prior once
+		if (j != decoded)
 		{
-
-			if (conf_per_class[j] > confThreshold) 
-			{
-				Box b;
-				b.cl = i;
-				b.prob = conf_per_class[j];
-				b.x = locations_h[j * N_COORDS + 0];
-				b.y = locations_h[j * N_COORDS + 1];
-				b.w = locations_h[j * N_COORDS + 2];
-				b.h = locations_h[j * N_COORDS + 3];
-
-				boxes.push_back(b);
-			}
+			box = MobileNet::DecodeBox(&locations_h[j * N_COORDS], priors, j);
+			decoded = j;
 		}
-		std::sort(boxes.begin(), boxes.end(), GreaterProbability);
+		nms.Candidates(cl).Add(probability, box[0], box[1], box[2], box[3]);
+	}
 
-		std::vector<Box> remaining;
-		while (!boxes.empty()) 
-		{
-			remaining.clear();
-
-			Box b;
-			b.cl = boxes[0].cl - 1;             //remove background class
-			b.prob = boxes[0].prob;
-			b.x = boxes[0].x * width;
-			b.y = boxes[0].y * height;
-			b.w = boxes[0].w * width - b.x;     //convert from x1 to width
-			b.h = boxes[0].h * height - b.y;    //convert from y1 to height
-			detected.push_back(b);
-			for (size_t j = 1; j < boxes.size(); j++) 
-			{
-				if (IoU(boxes[0], boxes[j]) <= IoUThreshold) {
-					remaining.push_back(boxes[j]);
-				}
-			}
-			boxes = remaining;
-		}
+	std::vector<Box> detected;
+	for (const auto [cl, k] : nms.Run(IoUThreshold, nmsOptions.Algorithm, nmsOptions.TopK))
+	{
+		const auto& candidates = nms.Candidates(cl);
+		Box b;
+		b.cl = cl - 1;                               //remove background class
+		b.prob = candidates.Score[k];
+		b.x = candidates.X1[k] * width;
+		b.y = candidates.Y1[k] * height;
+		b.w = candidates.X2[k] * width - b.x;        //convert from x1 to width
+		b.h = candidates.Y2[k] * height - b.y;       //convert from y1 to height
+		detected.push_back(b);
 	}
 
 	return detected;
 }
 
-tuple<int, int, float> SoftMax(int candidates, int classNum, span<float> scores)
+std::vector<Box> MobileNet::Postprocess(span<const float> scores, span<const float> boxes, const SsdPriorsView& priors, const std::vector<int64_t>& scoresShape, const cv::Size& originalSize, float confThreshold, const NmsOptions& nmsOptions)
+{
+	const auto candidates = static_cast<size_t>(scoresShape[1]);
+	const auto classes = static_cast<size_t>(scoresShape[2]);
+
+	// the scores are [candidates, classes]: each row is normalized and thresholded in the same pass, the tensor is read
+	// once in memory order and only the (candidate, class, probability) above the threshold come out
+	// (the first column is the background: it takes part in the softmax but is never selected)
+	thread_local std::vector<RowProbability> selected;
+	selected.clear();
+	SoftmaxRowsAbove(scores.first(candidates * classes), classes, confThreshold, selected, 1);
+
+	return MobileNetPostprocess(selected, boxes, priors, classes, originalSize, nmsOptions);
+}
+
+static std::vector<Box> Postprocess(Ort::Value& scoresTensor, Ort::Value& boxesTensor, const SsdPriorsView& priors, const cv::Size& originalSize, float confThreshold, const NmsOptions& nmsOptions)
 {
-	int maxidx = 0;
-	auto maxval = 0.0f;
-	auto bestcandidate = 0;
+	return MobileNet::Postprocess(Utils::AsSpan(scoresTensor), Utils::AsSpan(boxesTensor), priors, scoresTensor.GetTensorTypeAndShapeInfo().GetShape(), originalSize, confThreshold, nmsOptions);
+}
+
+void MobileNet::PreprocessInto(const cv::Mat& frame, span<float> dst, SimdLevel level)
+{
+	// (x - 127) / 128, exact as x / 128 - 127 / 128
+	static const auto normalization = ChannelNormalization::FromMeanStd(1.0f, -127.0f, { 0.0f, 0.0f, 0.0f }, { 128.0f, 128.0f, 128.0f });
+	ResizeNormalizeToPlanar(frame, { 512, 512 }, normalization, dst, level);
+}
 
-	for (auto i = 0; i < candidates; ++i)
+static void SaveDetections(cv::Mat& frame, const std::vector<Box>& detectedBoundingBoxes, const std::array<cv::Scalar, 256>& colors, const std::filesystem::path& imagePath)
+{
+	// save output images with detected bounding boxes
 	{
-		const auto disp = classNum * i;
-		// remember to skip the first column because it's the background!
-		//                                      v
-		span subv(scores.data() + disp + 0, scores.data() + disp + classNum);
-		softmax(subv);
-		const auto subvmax = max_element(begin(subv), end(subv));
-
-		if (*subvmax > maxval)
-		{
-			maxidx = static_cast<int>(distance(begin(subv), subvmax));
-			maxval = *subvmax;
-			bestcandidate = i;
-		}
+		ScopeTimer timer{ Stage::Draw };
+		Drawing::DrawBoundingBoxes(frame, detectedBoundingBoxes, colors);
 	}
-
-	return { maxidx, bestcandidate, maxval };
+	const auto outputFileName = (std::filesystem::path("outdata") / imagePath.filename()).string();
+	const auto saved = [&] {
+		ScopeTimer timer{ Stage::Encode };
+		return cv::imwrite(outputFileName, frame);
+	}();
+	if (saved)
+		std::cout << "output saved into " << outputFileName << "\n\n";
 }
 
-std::vector<Box> Postprocess(Ort::Value& scoresTensor, Ort::Value& boxesTensor, const cv::Size& originalSize, float confThreshold)
+void Demo::RunMobileNet(bool steadyState, const NmsOptions& nmsOptions)
 {
-	const auto scores = Utils::AsSpan(scoresTensor);
-	const auto boxes = Utils::AsSpan(boxesTensor);
+	MobileNetModel mobileNet{ ModelRegistry::Instance().Get(LR"(data\mobileNet.onnx)") };
+	auto& model = mobileNet.Network;
 
-	const auto scoresShape = scoresTensor.GetTensorTypeAndShapeInfo().GetShape();
-	const auto candidates = static_cast<int>(scoresShape[1]);
-	const auto classes = static_cast<int>(scoresShape[2]);
+	const auto classes = static_cast<int>(model.Outputs[0].Shape[2]);
+	 
+	const auto colors = Drawing::MakeColors(classes);
 
-	auto [maxidx, bestcandidate, maxval] = SoftMax(candidates, classes, scores);
+	auto& profiler = StageProfiler::Instance();
+	profiler.Reset();
+
+	if (steadyState)
+	{
+		// input and output tensors are allocated and bound only once
+		SteadyStateSession session{ model };
+
+		ForEachImage(".jpg", "data", [&](cv::Mat& frame, const auto& imagePath) {
+			try
+			{
+				{
+					ScopeTimer timer{ Stage::Preprocess };
+					MobileNet::PreprocessInto(frame, session.Input());
+				}
+				{
+					ScopeTimer timer{ Stage::Run };
+					session.Run();
+				}
+				const auto detectedBoundingBoxes = [&] {
+					ScopeTimer timer{ Stage::Postprocess };
+					return MobileNet::Postprocess(session.Output(0), session.Output(1), mobileNet.Priors, session.OutputShape(0), frame.size(), 0.3f, nmsOptions);
+				}();
+				SaveDetections(frame, detectedBoundingBoxes, colors, imagePath);
+			}
+			catch (const exception& ex)
+			{
+				std::cout << ex.what() << "\n";
+			}
+		});
+		profiler.Print(std::cout);
+		return;
+	}
 
-	auto scoresXTensor = xt::adapt(scores.data(), scoresShape);
-	scoresXTensor = xt::transpose(scoresXTensor, { 0, 2, 1 });
+	// iterate over the .jpg contained in the input folder
+	ForEachImage(".jpg", "data", [&](cv::Mat& frame, const auto& imagePath) {
 
-	return MobileNetPostprocess(scores, boxes, classes, originalSize, confThreshold);
+		try
+		{
+			// a fresh tensor from the allocator of ORT for each frame, the preprocessing writes directly into it
+			auto input = [&] {
+				ScopeTimer timer{ Stage::Preprocess };
+				auto tensor = AllocateInput(model);
+				MobileNet::PreprocessInto(frame, tensor.Data);
+				return tensor;
+			}();
+
+			auto onnxOutputTensor = [&] {
+				ScopeTimer timer{ Stage::Run };
+				return model.Run(&input.Value, 1);
+			}();
+
+			const auto detectedBoundingBoxes = [&] {
+				ScopeTimer timer{ Stage::Postprocess };
+				return Postprocess(onnxOutputTensor[0], onnxOutputTensor[1], mobileNet.Priors, frame.size(), 0.3f, nmsOptions);
+			}();
+			SaveDetections(frame, detectedBoundingBoxes, colors, imagePath);
+		}
+		catch (const exception& ex)
+		{
+			std::cout << ex.what() << "\n";
+		}
+	});
+	profiler.Print(std::cout);
 }
 
-static auto PreprocessImageForMobileNet(const cv::Mat& frame)
+// detections are (x, y, width, height), Utils::IoU(Box, Box) wants corners
+static Box ToCorners(Box b)
 {
-	const auto prepocessed = RemoveMeanDivideByStd(frame, { 512, 512 });
-	xt::xarray<float> tens = xt::adapt(reinterpret_cast<float*>(prepocessed.data), { 1, prepocessed.cols, prepocessed.rows, 3 });
-	return xt::eval(xt::transpose(std::move(tens), { 0, 3, 1, 2 }));
+	b.w += b.x;
+	b.h += b.y;
+	return b;
 }
 
-void Demo::RunMobileNet()
+// detections of a without a detection of the same class in b that overlaps them by more than minIoU
+static size_t CountUnmatched(const std::vector<Box>& a, const std::vector<Box>& b, float minIoU)
 {
-	InitPriors();
-	
-	Ort::Env env;
-
-	const Ort::SessionOptions sessionOpts;
-	Ort::Session session{ env, LR"(data\mobileNet.onnx)", sessionOpts };
+	return std::count_if(begin(a), end(a), [&](const auto& box) {
+		return std::none_of(begin(b), end(b), [&](const auto& other) {
+			return other.cl == box.cl && IoU(ToCorners(box), ToCorners(other)) > minIoU;
+		});
+	});
+}
 
-	auto memoryInfo = Ort::MemoryInfo::CreateCpu(OrtDeviceAllocator, OrtMemTypeCPU);
+void Demo::CompareMobileNetNms(const NmsOptions& matrix)
+{
+	MobileNetModel mobileNet{ ModelRegistry::Instance().Get(LR"(data\mobileNet.onnx)") };
+	auto& model = mobileNet.Network;
+	SteadyStateSession session{ model };
 
-	auto outShape = GetOutputShape(session, 0);
-	const auto classes = static_cast<int>(outShape[2]);
-	 
-	const auto colors = Drawing::MakeColors(classes);
-	
-	std::vector inputNames = Utils::OnnxGetInputNames(session);
-	std::vector outputNames = Utils::OnnxGetOutputNames(session);
+	NmsOptions greedy = matrix;
+	greedy.Algorithm = NmsAlgorithm::Greedy;
 
-	const auto inputsAsConstCharPtr = Utils::MakeConstCharPtrVector(inputNames);
-	const auto outputsAsConstCharPtr = Utils::MakeConstCharPtrVector(outputNames);
+	struct Totals
+	{
+		size_t Detections = 0;
+		// detections the other algorithm has no match for
+		size_t Unmatched = 0;
+		std::chrono::nanoseconds Time{};
+	};
+	Totals greedyTotals, matrixTotals;
 
-	// iterate over the .jpg contained in the input folder
 	ForEachImage(".jpg", "data", [&](cv::Mat& frame, const auto& imagePath) {
+		try
+		{
+			MobileNet::PreprocessInto(frame, session.Input());
+			session.Run();
+
+			// the postprocessing only reads the outputs: both algorithms see the same ones
+			const auto postprocess = [&](const NmsOptions& options, Totals& totals) {
+				const auto start = std::chrono::steady_clock::now();
+				auto detections = MobileNet::Postprocess(session.Output(0), session.Output(1), mobileNet.Priors, session.OutputShape(0), frame.size(), 0.3f, options);
+				totals.Time += std::chrono::steady_clock::now() - start;
+				totals.Detections += detections.size();
+				return detections;
+			};
+			const auto greedyDetections = postprocess(greedy, greedyTotals);
+			const auto matrixDetections = postprocess(matrix, matrixTotals);
+
+			const auto onlyGreedy = CountUnmatched(greedyDetections, matrixDetections, 0.5f);
+			const auto onlyMatrix = CountUnmatched(matrixDetections, greedyDetections, 0.5f);
+			greedyTotals.Unmatched += onlyGreedy;
+			matrixTotals.Unmatched += onlyMatrix;
+			std::cout << imagePath.filename().string() << ": greedy " << greedyDetections.size() << ", matrix " << matrixDetections.size()
+				<< ", only greedy " << onlyGreedy << ", only matrix " << onlyMatrix << "\n";
+		}
+		catch (const exception& ex)
+		{
+			std::cout << ex.what() << "\n";
+		}
+	});
 
-		auto inputTensor = PreprocessImageForMobileNet(frame);
+	const auto print = [](const char* name, const Totals& totals) {
+		std::cout << name << ": " << totals.Detections << " detections, " << totals.Unmatched << " without a match, "
+			<< std::chrono::duration<double, std::milli>(totals.Time).count() << " ms of postprocessing\n";
+	};
+	print("greedy", greedyTotals);
+	print("matrix", matrixTotals);
+}
+
+struct PipelineItem
+{
+	std::filesystem::path Path;
+	cv::Mat Frame;
+	WritableTensor Input;
+	std::vector<Ort::Value> Outputs;
+	std::vector<Box> Detections;
+};
 
+// runs step on the items that still have a frame: an exception is reported with the path of the frame, whose item
+// then goes through the next stages empty
+template<typename Step>
+static auto PerFrame(Step step)
+{
+	return [step](PipelineItem item) {
+		if (item.Frame.empty())
+			return item;
 		try
 		{
-			std::vector<int64_t> inputShape(inputTensor.shape().begin(), inputTensor.shape().end());
-			auto onnxInputTensor = Ort::Value::CreateTensor<float>(memoryInfo,
-				inputTensor.data(), inputTensor.size(),
-				inputShape.data(), inputShape.size());
-
-			auto onnxOutputTensor = session.Run(Ort::RunOptions{ nullptr },
-				inputsAsConstCharPtr.data(), &onnxInputTensor, inputsAsConstCharPtr.size(),
-				outputsAsConstCharPtr.data(), outputsAsConstCharPtr.size());
-
-			const auto detectedBoundingBoxes = Postprocess(onnxOutputTensor[0], onnxOutputTensor[1], frame.size(), 0.3f);
-
-			// save output images with detected bounding boxes
-			Drawing::DrawBoundingBoxes(frame, detectedBoundingBoxes, colors);
-			const auto outputFileName = (std::filesystem::path("outdata") / imagePath.filename()).string();
-			if (cv::imwrite(outputFileName, frame))
-				std::cout << "output saved into " << outputFileName << "\n\n";
+			step(item);
 		}
 		catch (const exception& ex)
 		{
-			std::cout << ex.what() << "\n";
+			std::cout << item.Path.string() << ": " << ex.what() << "\n";
+			auto path = std::move(item.Path);
+			item = PipelineItem{};
+			item.Path = std::move(path);
+		}
+		return item;
+	};
+}
+
+Demo::MobileNetPipelineOptions Demo::MobileNetPipelineOptions::FromBudget(const ThreadBudget& budget)
+{
+	const auto imageWorkers = static_cast<size_t>(std::max(budget.ImageWorkers, 1));
+	MobileNetPipelineOptions options;
+	options.DecodeWorkers = std::max<size_t>(1, (imageWorkers + 2) / 3);
+	options.PreprocessWorkers = std::max<size_t>(1, (imageWorkers + 1) / 3);
+	options.EncodeWorkers = std::max<size_t>(1, imageWorkers / 3);
+	options.InferenceWorkers = 1;
+	options.PostprocessWorkers = 1;
+	return options;
+}
+
+void Demo::RunMobileNetPipelined(const MobileNetPipelineOptions& options)
+{
+	MobileNetModel mobileNet{ ModelRegistry::Instance().Get(LR"(data\mobileNet.onnx)") };
+	auto& model = mobileNet.Network;
+	const auto classes = static_cast<int>(model.Outputs[0].Shape[2]);
+	const auto colors = Drawing::MakeColors(classes);
+	StageProfiler::Instance().Reset();
+
+	Pipeline pipeline;
+	auto& paths = pipeline.MakeQueue<std::filesystem::path>(options.QueueCapacity);
+	auto& decoded = pipeline.MakeQueue<PipelineItem>(options.QueueCapacity);
+	auto& preprocessed = pipeline.MakeQueue<PipelineItem>(options.QueueCapacity);
+	auto& inferred = pipeline.MakeQueue<PipelineItem>(options.QueueCapacity);
+	auto& postprocessed = pipeline.MakeQueue<PipelineItem>(options.QueueCapacity);
+
+	pipeline.AddSource("list", paths, [it = std::filesystem::directory_iterator("data")]() mutable -> std::optional<std::filesystem::path> {
+		for (; it != std::filesystem::directory_iterator{}; ++it)
+		{
+			if (it->is_regular_file() && it->path().extension() == ".jpg")
+			{
+				auto path = it->path();
+				++it;
+				return path;
+			}
 		}
+		return std::nullopt;
 	});
+
+	// like in RunMobileNet, a frame that cannot be read or processed is reported and skipped instead of aborting the run
+	pipeline.AddStage("decode", options.DecodeWorkers, paths, decoded, [](std::filesystem::path path) {
+		PipelineItem item;
+		item.Frame = ReadImage(path);
+		if (item.Frame.empty())
+			std::cout << "cannot read " << path.string() << "\n";
+		item.Path = std::move(path);
+		return item;
+	});
+
+	// each item owns its input tensor: the preprocessing fills it and the inference runs on it without copies
+	pipeline.AddStage("preprocess", options.PreprocessWorkers, decoded, preprocessed, PerFrame([&](PipelineItem& item) {
+		ScopeTimer timer{ Stage::Preprocess };
+		item.Input = AllocateInput(model);
+		MobileNet::PreprocessInto(item.Frame, item.Input.Data);
+	}));
+
+	pipeline.AddStage("inference", options.InferenceWorkers, preprocessed, inferred, PerFrame([&](PipelineItem& item) {
+		{
+			ScopeTimer timer{ Stage::Run };
+			item.Outputs = model.Run(&item.Input.Value, 1);
+		}
+		item.Input = {};
+	}));
+
+	pipeline.AddStage("postprocess", options.PostprocessWorkers, inferred, postprocessed, PerFrame([&](PipelineItem& item) {
+		{
+			ScopeTimer timer{ Stage::Postprocess };
+			item.Detections = Postprocess(item.Outputs[0], item.Outputs[1], mobileNet.Priors, item.Frame.size(), 0.3f, options.Nms);
+		}
+		item.Outputs.clear();
+	}));
+
+	pipeline.AddSink("encode", options.EncodeWorkers, postprocessed, PerFrame([&](PipelineItem& item) {
+		SaveDetections(item.Frame, item.Detections, colors, item.Path);
+	}));
+
+	pipeline.Run();
+	pipeline.PrintMetrics(std::cout);
+	StageProfiler::Instance().Print(std::cout);
 }
\ No newline at end of file
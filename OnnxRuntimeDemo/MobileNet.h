@@ -1,6 +1,54 @@
 #pragma once
+#include <opencv2/core/mat.hpp>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "Box.h"
+#include "CpuFeatures.h"
+#include "Nms.h"
+#include "SsdPriors.h"
+#include "ThreadBudget.h"
+#include "span.h"
+
+namespace MobileNet
+{
+	// resizes to 512x512, normalizes and writes planar CHW into dst
+	void PreprocessInto(const cv::Mat& frame, Utils::span<float> dst, Utils::SimdLevel level = Utils::BestSimdLevel());
+
+	// corners (x1, y1, x2, y2) of the box of prior j: location is (x center, y center, width, height) relative to the prior
+	std::array<float, 4> DecodeBox(const float* location, const Utils::SsdPriorsView& priors, std::uint32_t j);
+
+	// scores [candidates, classes] and boxes [candidates, 4] as the network outputs them: the detections above
+	// confThreshold that survive the suppression, as (x, y, width, height) in the pixels of originalSize
+	std::vector<Utils::Box> Postprocess(Utils::span<const float> scores, Utils::span<const float> boxes, const Utils::SsdPriorsView& priors, const std::vector<int64_t>& scoresShape, const cv::Size& originalSize, float confThreshold, const Utils::NmsOptions& nmsOptions);
+}
 
 namespace Demo
 {
-	void RunMobileNet();
+	// in steady state mode the tensors are allocated once and bound to the session
+	void RunMobileNet(bool steadyState = true, const Utils::NmsOptions& nmsOptions = {});
+
+	// postprocesses the outputs of each image of data with greedy and with matrix suppression, then prints
+	// the detections each one finds that the other does not (same class and IoU above 0.5) and the time spent
+	void CompareMobileNetNms(const Utils::NmsOptions& matrix = { Utils::NmsMode::PerClass, Utils::NmsAlgorithm::Matrix });
+
+	// number of workers of each stage of the pipeline
+	struct MobileNetPipelineOptions
+	{
+		size_t DecodeWorkers = 2;
+		size_t PreprocessWorkers = 2;
+		size_t InferenceWorkers = 1;
+		size_t PostprocessWorkers = 1;
+		size_t EncodeWorkers = 2;
+		size_t QueueCapacity = 4;
+		Utils::NmsOptions Nms;
+
+		// the image workers of the budget are shared by decode, preprocess and encode (one each at least),
+		// inference and postprocess get one worker: ORT and the NMS pool have threads of their own
+		static MobileNetPipelineOptions FromBudget(const Utils::ThreadBudget& budget = Utils::ThreadBudget::Current());
+	};
+
+	// decode, preprocess, inference, postprocess and encode overlap: each stage runs on its own workers
+	void RunMobileNetPipelined(const MobileNetPipelineOptions& options = MobileNetPipelineOptions::FromBudget());
 }
\ No newline at end of file
@@ -0,0 +1,151 @@
+#include "ModelRegistry.h"
+#include "Utils.h"
+#include <iostream>
+#include <optional>
+
+static std::vector<Utils::TensorInfo> MakeTensorInfos(const std::vector<std::string>& names, Ort::TypeInfo(Ort::Session::*typeInfoGetter)(size_t) const, Ort::Session& session)
+{
+	std::vector<Utils::TensorInfo> infos;
+	for (size_t i = 0; i < names.size(); ++i)
+	{
+		const auto tensorInfo = std::invoke(typeInfoGetter, session, i).GetTensorTypeAndShapeInfo();
+		infos.push_back({ names[i], tensorInfo.GetShape(), tensorInfo.GetElementType() });
+	}
+	return infos;
+}
+
+static std::vector<const char*> MakeNamePointers(const std::vector<Utils::TensorInfo>& infos)
+{
+	std::vector<const char*> out(infos.size());
+	std::transform(begin(infos), end(infos), begin(out), [](const auto& info) {
+		return info.Name.c_str();
+	});
+	return out;
+}
+
+Utils::Model::Model(Ort::Env& env, const std::filesystem::path& modelPath, const Ort::SessionOptions& options)
+	: Session{ env, modelPath.c_str(), options }
+{
+	Inputs = MakeTensorInfos(OnnxGetInputNames(Session), &Ort::Session::GetInputTypeInfo, Session);
+	Outputs = MakeTensorInfos(OnnxGetOutputNames(Session), &Ort::Session::GetOutputTypeInfo, Session);
+	InputNames = MakeNamePointers(Inputs);
+	OutputNames = MakeNamePointers(Outputs);
+}
+
+std::vector<Ort::Value> Utils::Model::Run(const Ort::Value* inputValues, size_t inputCount, const Ort::RunOptions& runOptions)
+{
+	return Session.Run(runOptions,
+		InputNames.data(), inputValues, inputCount,
+		OutputNames.data(), OutputNames.size());
+}
+
+struct ThreadingOptionsDeleter
+{
+	void operator()(OrtThreadingOptions* options) const
+	{
+		Ort::GetApi().ReleaseThreadingOptions(options);
+	}
+};
+
+static Ort::Env MakeEnv(Utils::EnvMode mode, const Utils::ThreadBudget* budget)
+{
+	if (mode == Utils::EnvMode::PerSessionThreads)
+	{
+		return Ort::Env{};
+	}
+
+	const auto& api = Ort::GetApi();
+	OrtThreadingOptions* rawOptions = nullptr;
+	Ort::ThrowOnError(api.CreateThreadingOptions(&rawOptions));
+	const std::unique_ptr<OrtThreadingOptions, ThreadingOptionsDeleter> options{ rawOptions };
+	
+	const auto threads = budget ? *budget : Utils::ThreadBudget::Split();
+	Ort::ThrowOnError(api.SetGlobalIntraOpNumThreads(options.get(), threads.IntraOpThreads));
+	Ort::ThrowOnError(api.SetGlobalInterOpNumThreads(options.get(), threads.InterOpThreads));
+	Ort::ThrowOnError(api.SetGlobalSpinControl(options.get(), threads.AllowSpinning ? 1 : 0));
+	return Ort::Env{ options.get(), ORT_LOGGING_LEVEL_WARNING, "OnnxRuntimeDemo" };
+}
+
+// set by Configure, read only once when the registry is created
+static Utils::EnvMode configuredMode = Utils::EnvMode::PerSessionThreads;
+static std::optional<Utils::ThreadBudget> configuredBudget;
+static bool registryCreated = false;
+
+Utils::ModelRegistry::ModelRegistry(EnvMode mode, const ThreadBudget* budget)
+	: mode(mode), budget(budget), env(MakeEnv(mode, budget))
+{
+}
+
+Utils::ModelRegistry& Utils::ModelRegistry::Instance()
+{
+	static ModelRegistry registry = [] {
+		registryCreated = true;
+		return ModelRegistry{ configuredMode, configuredBudget ? &*configuredBudget : nullptr };
+	}();
+	return registry;
+}
+
+void Utils::ModelRegistry::Configure(EnvMode mode, const ThreadBudget& budget)
+{
+	if (registryCreated)
+	{
+		throw std::logic_error("ModelRegistry::Configure must be called before the registry is used");
+	}
+	configuredMode = mode;
+	configuredBudget = budget;
+	budget.ApplyToOpenCv();
+	budget.MakeCurrent();
+}
+
+Utils::Model& Utils::ModelRegistry::Get(const std::filesystem::path& modelPath, const Ort::SessionOptions& options)
+{
+	// loading happens under the lock so that the same model is never parsed twice
+	std::lock_guard lock{ mutex };
+	auto& model = models[modelPath];
+	if (!model)
+	{
+		auto sessionOptions = options.Clone();
+		if (mode == EnvMode::GlobalThreadPools)
+		{
+			sessionOptions.DisablePerSessionThreads();
+		}
+		else if (budget)
+		{
+			sessionOptions.SetIntraOpNumThreads(budget->IntraOpThreads);
+			sessionOptions.SetInterOpNumThreads(budget->InterOpThreads);
+		}
+		// ORT appends the date to the prefix
+		const bool profiling = Tracer::Enabled();
+		auto profilePrefix = std::filesystem::path{ "ort_profile_" } += modelPath.stem();
+		if (profiling)
+		{
+			sessionOptions.EnableProfiling(profilePrefix.c_str());
+		}
+		model = std::make_unique<Model>(env, modelPath, sessionOptions);
+		model->Profiling = profiling;
+	}
+	else if (Tracer::Enabled() && !model->Profiling)
+	{
+		std::cout << "tracing: " << modelPath.string() << " was loaded without profiling, its operators will not be in the trace\n";
+	}
+	return *model;
+}
+
+std::vector<Utils::OrtProfile> Utils::ModelRegistry::EndProfiling()
+{
+	std::lock_guard lock{ mutex };
+	std::vector<OrtProfile> profiles;
+	for (auto& [path, model] : models)
+	{
+		if (!model->Profiling)
+			continue;
+		profiles.push_back({ OnnxEndProfiling(model->Session), model->Created });
+		model->Profiling = false;
+	}
+	return profiles;
+}
+
+Ort::Env& Utils::ModelRegistry::Env()
+{
+	return env;
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include <onnxruntime_cxx_api.h>
+#include <chrono>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "ThreadBudget.h"
+#include "Tracing.h"
+
+namespace Utils
+{
+	struct TensorInfo
+	{
+		std::string Name;
+		std::vector<std::int64_t> Shape;
+		ONNXTensorElementDataType ElementType = ONNX_TENSOR_ELEMENT_DATA_TYPE_UNDEFINED;
+	};
+
+	// a loaded session together with the metadata we would otherwise query on every call
+	// (Session::Run is safe to call concurrently, metadata is never modified after loading)
+	class Model
+	{
+	public:
+		Model(Ort::Env& env, const std::filesystem::path& modelPath, const Ort::SessionOptions& options);
+		Model(const Model&) = delete;
+		Model& operator=(const Model&) = delete;
+
+		std::vector<Ort::Value> Run(const Ort::Value* inputValues, size_t inputCount, const Ort::RunOptions& runOptions = Ort::RunOptions{ nullptr });
+
+		// taken right before the session is created, when the profiler of ORT starts counting
+		std::chrono::steady_clock::time_point Created = std::chrono::steady_clock::now();
+		Ort::Session Session;
+		std::vector<TensorInfo> Inputs;
+		std::vector<TensorInfo> Outputs;
+		// these point into Inputs and Outputs, ready to be passed to Session::Run
+		std::vector<const char*> InputNames;
+		std::vector<const char*> OutputNames;
+		// the session writes the profile of its operators until EndProfiling
+		bool Profiling = false;
+	};
+
+	enum class EnvMode
+	{
+		// each session creates its own intra/inter-op pools (ORT default)
+		PerSessionThreads,
+		// all the sessions share the pools of the environment
+		GlobalThreadPools,
+	};
+
+	// process-wide cache of models: one Ort::Env shared by all the sessions, each model loaded only once
+	class ModelRegistry
+	{
+	public:
+		static ModelRegistry& Instance();
+		// must be called before the first call to Instance(), cores not given to ORT are left to OpenCV and to our workers
+		static void Configure(EnvMode mode, const ThreadBudget& budget);
+
+		// options are used only the first time a model is loaded, profiling is turned on when the Tracer is enabled
+		Model& Get(const std::filesystem::path& modelPath, const Ort::SessionOptions& options = Ort::SessionOptions{});
+		// stops the profiling sessions and returns the files they wrote, ready for Tracer::Write
+		std::vector<OrtProfile> EndProfiling();
+		Ort::Env& Env();
+
+	private:
+		ModelRegistry(EnvMode mode, const ThreadBudget* budget);
+
+		EnvMode mode;
+		const ThreadBudget* budget;
+		Ort::Env env;
+		std::mutex mutex;
+		std::map<std::filesystem::path, std::unique_ptr<Model>> models;
+	};
+}
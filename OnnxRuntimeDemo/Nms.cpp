@@ -0,0 +1,256 @@
+#include "Nms.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+
+void Utils::NmsCandidates::Clear()
+{
+	Score.clear();
+	X1.clear();
+	Y1.clear();
+	X2.clear();
+	Y2.clear();
+}
+
+void Utils::NmsCandidates::Add(float score, float x1, float y1, float x2, float y2)
+{
+	Score.push_back(score);
+	X1.push_back(x1);
+	Y1.push_back(y1);
+	X2.push_back(x2);
+	Y2.push_back(y2);
+}
+
+size_t Utils::NmsCandidates::Size() const
+{
+	return Score.size();
+}
+
+void Utils::NmsEngine::Clear()
+{
+	Candidates.Clear();
+	kept.clear();
+}
+
+const std::vector<std::uint32_t>& Utils::NmsEngine::Kept() const
+{
+	return kept;
+}
+
+void Utils::NmsEngine::Sort(size_t limit)
+{
+	order.resize(Candidates.Size());
+	std::iota(begin(order), end(order), 0u);
+	std::stable_sort(begin(order), end(order), [&](auto a, auto b) {
+		return Candidates.Score[a] > Candidates.Score[b];
+	});
+	if (order.size() > limit)
+	{
+		order.resize(limit);
+	}
+
+	// corners in the (x, y, w, h) fields, as IoU(const Box&, const BoxSet&) wants them
+	sorted.Clear();
+	for (const auto k : order)
+	{
+		sorted.Add(Candidates.X1[k], Candidates.Y1[k], Candidates.X2[k], Candidates.Y2[k]);
+	}
+	row.resize(order.size());
+}
+
+Utils::Box Utils::NmsEngine::SortedBox(std::uint32_t i) const
+{
+	Box box;
+	box.x = sorted.X[i];
+	box.y = sorted.Y[i];
+	box.w = sorted.W[i];
+	box.h = sorted.H[i];
+	return box;
+}
+
+const std::vector<std::uint32_t>& Utils::NmsEngine::Run(float iouThreshold)
+{
+	Sort(Candidates.Size());
+	const auto count = static_cast<std::uint32_t>(order.size());
+
+	// bit i is set while the i-th box in score order is still alive: the inner loop visits only those,
+	// jumping from one set bit to the next, and suppressing a box clears its bit
+	alive.assign((count + 63) / 64, ~std::uint64_t{});
+	if (count % 64 != 0)
+	{
+		alive.back() = (std::uint64_t{ 1 } << (count % 64)) - 1;
+	}
+	kept.clear();
+	for (auto word = 0u; word < alive.size(); ++word)
+	{
+		while (alive[word] != 0)
+		{
+			// the best alive box is kept and removed from the mask
+			const auto i = word * 64 + CountTrailingZeros(alive[word]);
+			alive[word] &= alive[word] - 1;
+			kept.push_back(order[i]);
+
+			// the IoU of the kept box with all the boxes after it at once, then the alive ones above the threshold die
+			const auto ious = IoU(SortedBox(i), sorted, row, i + 1);
+			for (auto other = word; other < alive.size(); ++other)
+			{
+				for (auto bits = alive[other]; bits != 0; bits &= bits - 1)
+				{
+					const auto bit = CountTrailingZeros(bits);
+					if (ious[other * 64 + bit - i - 1] > iouThreshold)
+					{
+						alive[other] &= ~(std::uint64_t{ 1 } << bit);
+					}
+				}
+			}
+		}
+	}
+	return kept;
+}
+
+Utils::MultiClassNms::MultiClassNms(NmsMode mode, ThreadPool* pool)
+	: mode(mode), pool(pool)
+{
+	if (mode == NmsMode::ParallelPerClass && !pool)
+	{
+		throw std::invalid_argument("MultiClassNms: ParallelPerClass needs a thread pool");
+	}
+}
+
+const std::vector<std::uint32_t>& Utils::NmsEngine::RunMatrix(float iouThreshold, size_t topK, SimdLevel level)
+{
+	Sort(topK);
+	const auto count = static_cast<std::uint32_t>(order.size());
+
+	// the upper triangle of the IoU matrix one row at a time, each row reduced into the column maxima: every row is
+	// independent of the suppressions, so the whole triangle is branch free
+	maxIoU.assign(count, 0.0f);
+	for (auto i = 0u; i + 1 < count; ++i)
+	{
+		const auto ious = IoU(SortedBox(i), sorted, row, i + 1, level);
+		auto* columns = maxIoU.data() + i + 1;
+		for (size_t j = 0; j < ious.size(); ++j)
+		{
+			columns[j] = ious[j] > columns[j] ? ious[j] : columns[j];
+		}
+	}
+
+	// each box is decided on its own column: no box waits for the fate of a better one
+	kept.clear();
+	for (auto j = 0u; j < count; ++j)
+	{
+		if (!(maxIoU[j] > iouThreshold))
+		{
+			kept.push_back(order[j]);
+		}
+	}
+	return kept;
+}
+
+void Utils::MultiClassNms::Clear(size_t classes)
+{
+	if (engines.size() < classes)
+	{
+		engines.resize(classes);
+	}
+	for (auto& engine : engines)
+	{
+		engine.Clear();
+	}
+}
+
+Utils::NmsCandidates& Utils::MultiClassNms::Candidates(size_t cl)
+{
+	return engines[cl].Candidates;
+}
+
+// one suppression with the chosen algorithm
+static const std::vector<std::uint32_t>& RunEngine(Utils::NmsEngine& engine, float iouThreshold, Utils::NmsAlgorithm algorithm, size_t topK)
+{
+	if (algorithm == Utils::NmsAlgorithm::Matrix)
+		return engine.RunMatrix(iouThreshold, topK);
+	return engine.Run(iouThreshold);
+}
+
+const std::vector<Utils::MultiClassNms::Detection>& Utils::MultiClassNms::Run(float iouThreshold, NmsAlgorithm algorithm, size_t topK)
+{
+	detections.clear();
+	if (mode == NmsMode::Batched)
+	{
+		RunBatched(iouThreshold, algorithm, topK);
+		return detections;
+	}
+
+	if (mode == NmsMode::ParallelPerClass)
+	{
+		// each task writes only into its own engine, the results are read after Wait in class order
+		// the group waits only for the classes of this call, the pool may run the ones of other frames at the same time
+		TaskGroup tasks{ *pool };
+		for (auto& engine : engines)
+		{
+			if (engine.Candidates.Size() > 0)
+			{
+				tasks.Submit([&engine, iouThreshold, algorithm, topK] { RunEngine(engine, iouThreshold, algorithm, topK); });
+			}
+		}
+		tasks.Wait();
+	}
+
+	for (auto cl = 0u; cl < engines.size(); ++cl)
+	{
+		auto& engine = engines[cl];
+		if (engine.Candidates.Size() == 0)
+			continue;
+		const auto& kept = mode == NmsMode::ParallelPerClass ? engine.Kept() : RunEngine(engine, iouThreshold, algorithm, topK);
+		for (const auto index : kept)
+		{
+			detections.push_back({ cl, index });
+		}
+	}
+	return detections;
+}
+
+void Utils::MultiClassNms::RunBatched(float iouThreshold, NmsAlgorithm algorithm, size_t topK)
+{
+	// boxes of class c are shifted by c * offset, where offset is larger than any extent of the boxes:
+	// boxes of different classes end up disjoint and the single suppression never mixes classes
+	auto low = std::numeric_limits<float>::max();
+	auto high = std::numeric_limits<float>::lowest();
+	for (const auto& engine : engines)
+	{
+		const auto& c = engine.Candidates;
+		for (const auto* coordinates : { &c.X1, &c.Y1, &c.X2, &c.Y2 })
+		{
+			for (const auto value : *coordinates)
+			{
+				low = std::min(low, value);
+				high = std::max(high, value);
+			}
+		}
+	}
+	const auto offset = high - low + 1.0f;
+
+	batched.Clear();
+	batchedSource.clear();
+	for (auto cl = 0u; cl < engines.size(); ++cl)
+	{
+		const auto& c = engines[cl].Candidates;
+		const auto shift = cl * offset;
+		for (auto i = 0u; i < c.Size(); ++i)
+		{
+			batched.Candidates.Add(c.Score[i], c.X1[i] + shift, c.Y1[i] + shift, c.X2[i] + shift, c.Y2[i] + shift);
+			batchedSource.push_back({ cl, i });
+		}
+	}
+
+	for (const auto index : RunEngine(batched, iouThreshold, algorithm, topK))
+	{
+		detections.push_back(batchedSource[index]);
+	}
+	// kept boxes come in global score order, a stable sort by class gives class then score like the other modes
+	std::stable_sort(begin(detections), end(detections), [](const auto& a, const auto& b) {
+		return a.Class < b.Class;
+	});
+}
@@ -0,0 +1,124 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "Box.h"
+#include "CpuFeatures.h"
+
+namespace Utils
+{
+	// candidates of a suppression as a structure of arrays, boxes are corners (x1, y1, x2, y2)
+	struct NmsCandidates
+	{
+		std::vector<float> Score;
+		std::vector<float> X1;
+		std::vector<float> Y1;
+		std::vector<float> X2;
+		std::vector<float> Y2;
+
+		void Clear();
+		void Add(float score, float x1, float y1, float x2, float y2);
+		size_t Size() const;
+	};
+
+	// greedy non maximum suppression on indices: candidates are never copied around, suppression clears bits of a mask
+	// the buffers grow to the largest frame seen and are reused afterwards (keep one engine per thread)
+	class NmsEngine
+	{
+	public:
+		// filled by the caller, cleared by Clear()
+		NmsCandidates Candidates;
+
+		void Clear();
+
+		// indices into Candidates of the kept boxes, highest score first (ties keep the order of Add)
+		// a box is suppressed when its IoU with a kept box is above iouThreshold (same IoU as Utils::IoU(Box, Box))
+		const std::vector<std::uint32_t>& Run(float iouThreshold);
+		// Fast-NMS on the topK best candidates, the others are dropped: a box is suppressed when its IoU with any better box
+		// is above iouThreshold, even if that better box is itself suppressed. It may keep fewer boxes than Run, but the
+		// IoU matrix has no sequential dependency: it is computed with SIMD and every suppression is decided at once
+		const std::vector<std::uint32_t>& RunMatrix(float iouThreshold, size_t topK, SimdLevel level = BestSimdLevel());
+		// the result of the last Run or RunMatrix
+		const std::vector<std::uint32_t>& Kept() const;
+
+	private:
+		// fills order and sorted with the best limit candidates
+		void Sort(size_t limit);
+
+		Box SortedBox(std::uint32_t i) const;
+
+		std::vector<std::uint32_t> order;
+		// the boxes sorted by score, so that the IoU of a box with all the next ones is one vectorized call
+		BoxSet sorted;
+		// IoU of one box with the next ones
+		std::vector<float> row;
+		std::vector<std::uint64_t> alive;
+		// RunMatrix: for each box, the largest IoU with a better box
+		std::vector<float> maxIoU;
+		std::vector<std::uint32_t> kept;
+	};
+
+	class ThreadPool;
+
+	enum class NmsMode
+	{
+		// one suppression per class, one class after the other
+		PerClass,
+		// boxes are shifted by class so that boxes of different classes never overlap: one suppression for all the classes.
+		// Not equivalent to PerClass: the shifted coordinates are rounded, so a few IoU close to the threshold land on the
+		// other side of it and a few detections differ (e.g. 19 of 8200 in a crowded frame). It is also slower with many active classes
+		Batched,
+		// one suppression per class, the classes are spread across the workers of a pool
+		ParallelPerClass,
+	};
+
+	enum class NmsAlgorithm
+	{
+		// NmsEngine::Run: exact greedy suppression
+		Greedy,
+		// NmsEngine::RunMatrix: Fast-NMS on the best candidates, may suppress a few more boxes
+		Matrix,
+	};
+
+	struct NmsOptions
+	{
+		NmsMode Mode = NmsMode::PerClass;
+		NmsAlgorithm Algorithm = NmsAlgorithm::Greedy;
+		// Matrix only: candidates kept per suppression (Batched has a single suppression for all the classes)
+		size_t TopK = 200;
+	};
+
+	// non maximum suppression of several classes: a box is suppressed only by boxes of its own class
+	class MultiClassNms
+	{
+	public:
+		struct Detection
+		{
+			std::uint32_t Class;
+			// into Candidates(Class)
+			std::uint32_t Index;
+		};
+
+		// ParallelPerClass needs a pool, which may be shared: Run waits only for its own tasks (never call it from a worker of the pool)
+		explicit MultiClassNms(NmsMode mode = NmsMode::PerClass, ThreadPool* pool = nullptr);
+
+		// empties the candidates of all the classes, keeps the memory
+		void Clear(size_t classes);
+		NmsCandidates& Candidates(size_t cl);
+
+		// ordered by class then by decreasing score, whatever the mode and the order the classes complete in
+		const std::vector<Detection>& Run(float iouThreshold, NmsAlgorithm algorithm = NmsAlgorithm::Greedy, size_t topK = NmsOptions{}.TopK);
+
+	private:
+		void RunBatched(float iouThreshold, NmsAlgorithm algorithm, size_t topK);
+
+		NmsMode mode;
+		ThreadPool* pool;
+		// one engine per class, so that classes can run concurrently
+		std::vector<NmsEngine> engines;
+		NmsEngine batched;
+		// class and index of each batched candidate
+		std::vector<Detection> batchedSource;
+		std::vector<Detection> detections;
+	};
+}
@@ -0,0 +1,75 @@
+#include "Pipeline.h"
+#include <iomanip>
+#include <ostream>
+#include <thread>
+#include "Utils.h"
+
+void Utils::Pipeline::Run()
+{
+	const auto start = Clock::now();
+	{
+		std::vector<std::thread> threads;
+		defer_join_all guard{ threads };
+		for (auto& body : workerBodies)
+		{
+			threads.emplace_back([this, &body] {
+				try
+				{
+					body();
+				}
+				catch (...)
+				{
+					Abort(std::current_exception());
+				}
+			});
+		}
+	}
+	elapsedSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+	if (firstError)
+	{
+		std::rethrow_exception(firstError);
+	}
+}
+
+Utils::StageMetrics& Utils::Pipeline::AddMetrics(std::string name, size_t workers)
+{
+	auto& metrics = stages.emplace_back();
+	metrics.Name = std::move(name);
+	metrics.Workers = workers;
+	return metrics;
+}
+
+void Utils::Pipeline::Abort(std::exception_ptr error)
+{
+	{
+		std::lock_guard lock{ errorMutex };
+		if (!firstError)
+			firstError = error;
+	}
+	for (auto& abort : aborters)
+	{
+		abort();
+	}
+}
+
+void Utils::Pipeline::PrintMetrics(std::ostream& os) const
+{
+	// busy/starved/blocked are shares of the wall time of all the workers of the stage
+	os << std::fixed << std::setprecision(1);
+	for (const auto& stage : stages)
+	{
+		const auto workerNs = elapsedSeconds * 1e9 * stage.Workers;
+		const auto share = [=](std::uint64_t ns) { return workerNs > 0 ? 100.0 * ns / workerNs : 0.0; };
+		os << stage.Name << " x" << stage.Workers << ": " << stage.Processed << " items (" << (elapsedSeconds > 0 ? stage.Processed / elapsedSeconds : 0.0) << "/s)"
+			<< " busy " << share(stage.BusyNs) << "%"
+			<< " starved " << share(stage.WaitInputNs) << "%"
+			<< " blocked " << share(stage.WaitOutputNs) << "%";
+		if (stage.InputOccupancy)
+		{
+			os << " input queue " << stage.InputOccupancy() << "/" << stage.InputCapacity;
+		}
+		os << "\n";
+	}
+	os << std::defaultfloat;
+}
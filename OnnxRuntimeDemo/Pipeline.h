@@ -0,0 +1,262 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <iosfwd>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace Utils
+{
+	// blocking FIFO with a fixed capacity: producers wait when it's full (backpressure), consumers when it's empty
+	template<typename T>
+	class BoundedQueue
+	{
+	public:
+		explicit BoundedQueue(size_t capacity)
+			: capacity(capacity)
+		{
+		}
+
+		// false if the queue has been closed
+		bool Push(T item)
+		{
+			{
+				std::unique_lock lock{ mutex };
+				notFull.wait(lock, [this] { return closed || items.size() < capacity; });
+				if (closed)
+					return false;
+				items.push_back(std::move(item));
+				occupancySum += items.size();
+				++pushes;
+			}
+			notEmpty.notify_one();
+			return true;
+		}
+
+		// empty when the queue has been closed and all the remaining items have been popped
+		std::optional<T> Pop()
+		{
+			std::optional<T> item;
+			{
+				std::unique_lock lock{ mutex };
+				notEmpty.wait(lock, [this] { return closed || !items.empty(); });
+				if (items.empty())
+					return item;
+				item = std::move(items.front());
+				items.pop_front();
+			}
+			notFull.notify_one();
+			return item;
+		}
+
+		// no more pushes, consumers still get the items already in the queue
+		void Close()
+		{
+			{
+				std::lock_guard lock{ mutex };
+				closed = true;
+			}
+			notFull.notify_all();
+			notEmpty.notify_all();
+		}
+
+		// like Close but the items still in the queue are discarded
+		void Abort()
+		{
+			{
+				std::lock_guard lock{ mutex };
+				closed = true;
+				items.clear();
+			}
+			notFull.notify_all();
+			notEmpty.notify_all();
+		}
+
+		size_t Capacity() const
+		{
+			return capacity;
+		}
+
+		// average number of items in the queue right after a push
+		double AverageOccupancy() const
+		{
+			std::lock_guard lock{ mutex };
+			return pushes ? static_cast<double>(occupancySum) / pushes : 0.0;
+		}
+
+	private:
+		size_t capacity;
+		mutable std::mutex mutex;
+		std::condition_variable notFull;
+		std::condition_variable notEmpty;
+		std::deque<T> items;
+		bool closed = false;
+		std::uint64_t occupancySum = 0;
+		std::uint64_t pushes = 0;
+	};
+
+	struct StageMetrics
+	{
+		std::string Name;
+		size_t Workers = 0;
+		std::atomic<std::uint64_t> Processed{ 0 };
+		// summed over the workers of the stage
+		std::atomic<std::uint64_t> BusyNs{ 0 };
+		std::atomic<std::uint64_t> WaitInputNs{ 0 };
+		std::atomic<std::uint64_t> WaitOutputNs{ 0 };
+		// occupancy of the input queue of the stage (the source has none)
+		std::function<double()> InputOccupancy;
+		size_t InputCapacity = 0;
+	};
+
+	// stages run on their own workers and are connected by bounded queues
+	// a stage closes its output queue when all its workers are done, so the end of the input flows down to the sink
+	// the first exception thrown by a stage aborts all the queues and is rethrown by Run
+	class Pipeline
+	{
+	public:
+		template<typename T>
+		BoundedQueue<T>& MakeQueue(size_t capacity)
+		{
+			auto queue = std::make_shared<BoundedQueue<T>>(capacity);
+			aborters.push_back([queue] { queue->Abort(); });
+			queues.push_back(queue);
+			return *queue;
+		}
+
+		// calls produce (on a single worker) until it returns an empty optional
+		template<typename T, typename Producer>
+		void AddSource(std::string name, BoundedQueue<T>& out, Producer produce)
+		{
+			auto& metrics = AddMetrics(std::move(name), 1);
+			workerBodies.push_back([&out, &metrics, produce]() mutable {
+				const CloseOnLastExit guard{ std::make_shared<std::atomic<size_t>>(1), [&out] { out.Close(); } };
+				while (true)
+				{
+					const auto t0 = Clock::now();
+					auto item = produce();
+					const auto t1 = Clock::now();
+					metrics.BusyNs += Elapsed(t0, t1);
+					if (!item || !out.Push(std::move(*item)))
+						break;
+					metrics.WaitOutputNs += Elapsed(t1, Clock::now());
+					++metrics.Processed;
+				}
+			});
+		}
+
+		// workers must be at least 1: the output queue is closed by the last worker to exit
+		template<typename In, typename Out, typename Transform>
+		void AddStage(std::string name, size_t workers, BoundedQueue<In>& in, BoundedQueue<Out>& out, Transform transform)
+		{
+			if (workers == 0)
+			{
+				throw std::invalid_argument("Pipeline: stage " + name + " has no worker");
+			}
+			auto& metrics = AddMetrics(std::move(name), workers, in);
+			const auto remaining = std::make_shared<std::atomic<size_t>>(workers);
+			for (size_t i = 0; i < workers; ++i)
+			{
+				workerBodies.push_back([&in, &out, &metrics, remaining, transform]() mutable {
+					const CloseOnLastExit guard{ remaining, [&out] { out.Close(); } };
+					while (true)
+					{
+						const auto t0 = Clock::now();
+						auto item = in.Pop();
+						const auto t1 = Clock::now();
+						metrics.WaitInputNs += Elapsed(t0, t1);
+						if (!item)
+							break;
+						auto result = transform(std::move(*item));
+						const auto t2 = Clock::now();
+						metrics.BusyNs += Elapsed(t1, t2);
+						if (!out.Push(std::move(result)))
+							break;
+						metrics.WaitOutputNs += Elapsed(t2, Clock::now());
+						++metrics.Processed;
+					}
+				});
+			}
+		}
+
+		template<typename In, typename Consumer>
+		void AddSink(std::string name, size_t workers, BoundedQueue<In>& in, Consumer consume)
+		{
+			if (workers == 0)
+			{
+				throw std::invalid_argument("Pipeline: sink " + name + " has no worker");
+			}
+			auto& metrics = AddMetrics(std::move(name), workers, in);
+			for (size_t i = 0; i < workers; ++i)
+			{
+				workerBodies.push_back([&in, &metrics, consume]() mutable {
+					while (true)
+					{
+						const auto t0 = Clock::now();
+						auto item = in.Pop();
+						const auto t1 = Clock::now();
+						metrics.WaitInputNs += Elapsed(t0, t1);
+						if (!item)
+							break;
+						consume(std::move(*item));
+						metrics.BusyNs += Elapsed(t1, Clock::now());
+						++metrics.Processed;
+					}
+				});
+			}
+		}
+
+		// blocks until every item produced by the source went through the sink
+		void Run();
+		void PrintMetrics(std::ostream& os) const;
+
+	private:
+		using Clock = std::chrono::steady_clock;
+
+		static std::uint64_t Elapsed(Clock::time_point from, Clock::time_point to)
+		{
+			return std::chrono::duration_cast<std::chrono::nanoseconds>(to - from).count();
+		}
+
+		struct CloseOnLastExit
+		{
+			std::shared_ptr<std::atomic<size_t>> remaining;
+			std::function<void()> close;
+
+			~CloseOnLastExit()
+			{
+				if (--*remaining == 0)
+					close();
+			}
+		};
+
+		template<typename T>
+		StageMetrics& AddMetrics(std::string name, size_t workers, BoundedQueue<T>& in)
+		{
+			auto& metrics = AddMetrics(std::move(name), workers);
+			metrics.InputOccupancy = [&in] { return in.AverageOccupancy(); };
+			metrics.InputCapacity = in.Capacity();
+			return metrics;
+		}
+
+		StageMetrics& AddMetrics(std::string name, size_t workers);
+		void Abort(std::exception_ptr error);
+
+		std::vector<std::shared_ptr<void>> queues;
+		std::vector<std::function<void()>> aborters;
+		std::vector<std::function<void()>> workerBodies;
+		std::deque<StageMetrics> stages;
+		
+		std::mutex errorMutex;
+		std::exception_ptr firstError;
+		double elapsedSeconds = 0;
+	};
+}
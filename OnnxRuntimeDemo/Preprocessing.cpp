@@ -0,0 +1,56 @@
+#include "Preprocessing.h"
+#include <opencv2/imgproc/imgproc.hpp>
+#include "PreprocessingKernels.h"
+
+Utils::ChannelNormalization Utils::ChannelNormalization::FromMeanStd(float alpha, float beta, const std::array<float, 3>& mean, const std::array<float, 3>& std, bool swapRB)
+{
+	ChannelNormalization norm;
+	for (auto c = 0; c < 3; ++c)
+	{
+		norm.Scale[c] = alpha / std[c];
+		norm.Shift[c] = (beta - mean[c]) / std[c];
+	}
+	norm.SwapRB = swapRB;
+	return norm;
+}
+
+void Utils::ResizeNormalizeToPlanar(const cv::Mat& frame, cv::Size size, const ChannelNormalization& norm, span<float> dst, SimdLevel level)
+{
+	if (frame.size() == size)
+	{
+		NormalizeToPlanar(frame, norm, dst, level);
+		return;
+	}
+	thread_local cv::Mat resized;
+	cv::resize(frame, resized, size);
+	NormalizeToPlanar(resized, norm, dst, level);
+}
+
+void Utils::NormalizeToPlanar(const cv::Mat& frame, const ChannelNormalization& norm, span<float> dst, SimdLevel level)
+{
+	CV_Assert(frame.type() == CV_8UC3);
+	const auto width = frame.cols;
+	const auto height = frame.rows;
+	const auto planeSize = static_cast<size_t>(width) * height;
+	CV_Assert(dst.size() >= 3 * planeSize);
+
+	// each row is read once: 16 pixels at a time are split into their channels and written to the 3 planes
+	PlanarRowTargets targets{};
+	for (auto c = 0; c < 3; ++c)
+	{
+		const auto srcChannel = norm.SwapRB ? 2 - c : c;
+		targets.Planes[srcChannel] = dst.data() + c * planeSize;
+		targets.Scale[srcChannel] = norm.Scale[c];
+		targets.Shift[srcChannel] = norm.Shift[c];
+	}
+
+	const auto kernel = GetNormalizeRowKernel(level);
+	for (auto y = 0; y < height; ++y)
+	{
+		kernel(frame.ptr<std::uint8_t>(y), width, targets);
+		for (auto& plane : targets.Planes)
+		{
+			plane += width;
+		}
+	}
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include <array>
+#include <opencv2/core/mat.hpp>
+#include "span.h"
+#include "CpuFeatures.h"
+
+namespace Utils
+{
+	// output plane c is src[c] * Scale[c] + Shift[c]
+	struct ChannelNormalization
+	{
+		std::array<float, 3> Scale = { 1.0f, 1.0f, 1.0f };
+		std::array<float, 3> Shift = { 0.0f, 0.0f, 0.0f };
+		// the first output plane reads the R channel of the BGR image instead of B
+		bool SwapRB = false;
+
+		// (src * alpha + beta - mean) / std, as done by ResizeToFloat followed by the per-channel normalization, folded into
+		// src * Scale + Shift: not bit-identical to the two steps in general, but within a few ulp of the largest output
+		static ChannelNormalization FromMeanStd(float alpha, float beta, const std::array<float, 3>& mean, const std::array<float, 3>& std, bool swapRB = false);
+	};
+
+	// frame is 8-bit BGR, dst gets 3 planes of size.width x size.height floats (CHW)
+	// the resize is done on 8 bits (exactly like ResizeToFloat and RemoveMeanDivideByStd),
+	// then a single pass converts, normalizes and deinterleaves straight into dst
+	// the kernel is chosen at runtime from the instruction sets of the CPU, all the levels give the same result
+	void ResizeNormalizeToPlanar(const cv::Mat& frame, cv::Size size, const ChannelNormalization& norm, span<float> dst, SimdLevel level = BestSimdLevel());
+
+	// same as above when the frame has already the size of the destination
+	void NormalizeToPlanar(const cv::Mat& frame, const ChannelNormalization& norm, span<float> dst, SimdLevel level = BestSimdLevel());
+}
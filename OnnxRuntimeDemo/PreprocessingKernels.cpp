@@ -0,0 +1,166 @@
+#include "PreprocessingKernels.h"
+#include <array>
+#include <immintrin.h>
+
+// the levels must agree bit for bit: do not let the compiler fuse multiply and add (MSVC never does for intrinsics)
+#if defined(__clang__)
+#pragma STDC FP_CONTRACT OFF
+#elif defined(__GNUC__)
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+// pshufb masks extracting channel s of 16 interleaved pixels from the 16 bytes of the i-th load
+using DeinterleaveMasks = std::array<std::array<std::array<std::uint8_t, 16>, 3>, 3>;
+
+static constexpr DeinterleaveMasks MakeDeinterleaveMasks()
+{
+	DeinterleaveMasks masks{};
+	for (auto s = 0; s < 3; ++s)
+	{
+		for (auto load = 0; load < 3; ++load)
+		{
+			for (auto x = 0; x < 16; ++x)
+			{
+				const auto byte = x * 3 + s - load * 16;
+				masks[s][load][x] = byte >= 0 && byte < 16 ? static_cast<std::uint8_t>(byte) : 0x80;
+			}
+		}
+	}
+	return masks;
+}
+
+alignas(16) static constexpr DeinterleaveMasks Masks = MakeDeinterleaveMasks();
+
+static void NormalizeRowScalar(const std::uint8_t* src, int begin, int width, const Utils::PlanarRowTargets& t)
+{
+	for (auto x = begin; x < width; ++x)
+	{
+		for (auto s = 0; s < 3; ++s)
+		{
+			const float value = src[x * 3 + s] * t.Scale[s];
+			t.Planes[s][x] = value + t.Shift[s];
+		}
+	}
+}
+
+static void NormalizeRowScalar(const std::uint8_t* src, int width, const Utils::PlanarRowTargets& t)
+{
+	NormalizeRowScalar(src, 0, width, t);
+}
+
+// splits 16 BGR pixels (48 bytes) into 16 bytes per channel
+UTILS_TARGET("sse4.1")
+static inline void Deinterleave16(const std::uint8_t* src, __m128i channels[3])
+{
+	const auto a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+	const auto b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 16));
+	const auto c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 32));
+	for (auto s = 0; s < 3; ++s)
+	{
+		const auto fromA = _mm_shuffle_epi8(a, _mm_load_si128(reinterpret_cast<const __m128i*>(Masks[s][0].data())));
+		const auto fromB = _mm_shuffle_epi8(b, _mm_load_si128(reinterpret_cast<const __m128i*>(Masks[s][1].data())));
+		const auto fromC = _mm_shuffle_epi8(c, _mm_load_si128(reinterpret_cast<const __m128i*>(Masks[s][2].data())));
+		channels[s] = _mm_or_si128(_mm_or_si128(fromA, fromB), fromC);
+	}
+}
+
+UTILS_TARGET("sse4.1")
+static inline void Store4(float* dst, __m128i bytes, __m128 scale, __m128 shift)
+{
+	const auto values = _mm_cvtepi32_ps(_mm_cvtepu8_epi32(bytes));
+	_mm_storeu_ps(dst, _mm_add_ps(_mm_mul_ps(values, scale), shift));
+}
+
+UTILS_TARGET("sse4.1")
+static void NormalizeRowSse41(const std::uint8_t* src, int width, const Utils::PlanarRowTargets& t)
+{
+	__m128 scale[3], shift[3];
+	for (auto s = 0; s < 3; ++s)
+	{
+		scale[s] = _mm_set1_ps(t.Scale[s]);
+		shift[s] = _mm_set1_ps(t.Shift[s]);
+	}
+
+	auto x = 0;
+	for (; x + 16 <= width; x += 16)
+	{
+		__m128i channels[3];
+		Deinterleave16(src + x * 3, channels);
+		for (auto s = 0; s < 3; ++s)
+		{
+			auto* dst = t.Planes[s] + x;
+			Store4(dst, channels[s], scale[s], shift[s]);
+			Store4(dst + 4, _mm_srli_si128(channels[s], 4), scale[s], shift[s]);
+			Store4(dst + 8, _mm_srli_si128(channels[s], 8), scale[s], shift[s]);
+			Store4(dst + 12, _mm_srli_si128(channels[s], 12), scale[s], shift[s]);
+		}
+	}
+	NormalizeRowScalar(src, x, width, t);
+}
+
+UTILS_TARGET("avx2")
+static inline void Store8(float* dst, __m128i bytes, __m256 scale, __m256 shift)
+{
+	const auto values = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(bytes));
+	_mm256_storeu_ps(dst, _mm256_add_ps(_mm256_mul_ps(values, scale), shift));
+}
+
+UTILS_TARGET("avx2")
+static void NormalizeRowAvx2(const std::uint8_t* src, int width, const Utils::PlanarRowTargets& t)
+{
+	__m256 scale[3], shift[3];
+	for (auto s = 0; s < 3; ++s)
+	{
+		scale[s] = _mm256_set1_ps(t.Scale[s]);
+		shift[s] = _mm256_set1_ps(t.Shift[s]);
+	}
+
+	auto x = 0;
+	for (; x + 16 <= width; x += 16)
+	{
+		__m128i channels[3];
+		Deinterleave16(src + x * 3, channels);
+		for (auto s = 0; s < 3; ++s)
+		{
+			auto* dst = t.Planes[s] + x;
+			Store8(dst, channels[s], scale[s], shift[s]);
+			Store8(dst + 8, _mm_srli_si128(channels[s], 8), scale[s], shift[s]);
+		}
+	}
+	NormalizeRowScalar(src, x, width, t);
+}
+
+UTILS_TARGET("avx512f")
+static void NormalizeRowAvx512(const std::uint8_t* src, int width, const Utils::PlanarRowTargets& t)
+{
+	__m512 scale[3], shift[3];
+	for (auto s = 0; s < 3; ++s)
+	{
+		scale[s] = _mm512_set1_ps(t.Scale[s]);
+		shift[s] = _mm512_set1_ps(t.Shift[s]);
+	}
+
+	auto x = 0;
+	for (; x + 16 <= width; x += 16)
+	{
+		__m128i channels[3];
+		Deinterleave16(src + x * 3, channels);
+		for (auto s = 0; s < 3; ++s)
+		{
+			const auto values = _mm512_cvtepi32_ps(_mm512_cvtepu8_epi32(channels[s]));
+			_mm512_storeu_ps(t.Planes[s] + x, _mm512_add_ps(_mm512_mul_ps(values, scale[s]), shift[s]));
+		}
+	}
+	NormalizeRowScalar(src, x, width, t);
+}
+
+Utils::NormalizeRowKernel Utils::GetNormalizeRowKernel(SimdLevel level)
+{
+	switch (level)
+	{
+	case SimdLevel::Sse41: return NormalizeRowSse41;
+	case SimdLevel::Avx2: return NormalizeRowAvx2;
+	case SimdLevel::Avx512: return NormalizeRowAvx512;
+	default: return NormalizeRowScalar;
+	}
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include <cstdint>
+#include "CpuFeatures.h"
+
+namespace Utils
+{
+	// indexed by the channel of the source pixel
+	struct PlanarRowTargets
+	{
+		float* Planes[3];
+		float Scale[3];
+		float Shift[3];
+	};
+
+	// Planes[s][x] = src[x * 3 + s] * Scale[s] + Shift[s] for one row of 8-bit 3 channel pixels
+	// every level computes exactly the same values (multiply then add, no FMA)
+	using NormalizeRowKernel = void(*)(const std::uint8_t* src, int width, const PlanarRowTargets& targets);
+
+	NormalizeRowKernel GetNormalizeRowKernel(SimdLevel level);
+}
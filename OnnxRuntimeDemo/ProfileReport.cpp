@@ -0,0 +1,207 @@
+#include "ProfileReport.h"
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <map>
+#include <ostream>
+#include <string_view>
+#include <unordered_map>
+
+// ORT names the events of a node <node>_fence_before, <node>_kernel_time and <node>_fence_after: only the kernel counts
+static constexpr std::string_view KernelSuffix = "_kernel_time";
+
+static std::vector<Utils::OperatorStats> SortedByTime(std::unordered_map<std::string, Utils::OperatorStats>& stats)
+{
+	std::vector<Utils::OperatorStats> sorted;
+	sorted.reserve(stats.size());
+	for (auto& [name, stat] : stats)
+		sorted.push_back(std::move(stat));
+	std::sort(begin(sorted), end(sorted), [](const auto& a, const auto& b) {
+		return a.Microseconds > b.Microseconds;
+	});
+	return sorted;
+}
+
+Utils::ProfileSummary Utils::SummarizeProfile(const JsonValue& profile)
+{
+	// ORT writes a bare array of events, traces (e.g. the ones of Tracer) wrap it in traceEvents
+	const auto* traceEvents = profile.Find("traceEvents");
+	const auto& events = traceEvents ? traceEvents->Elements() : profile.Elements();
+
+	ProfileSummary summary;
+	std::unordered_map<std::string, OperatorStats> nodes, opTypes;
+	std::map<std::int64_t, double> busy;
+	for (const auto& event : events)
+	{
+		const auto* category = event.Find("cat");
+		const auto* name = event.Find("name");
+		const auto* duration = event.Find("dur");
+		if (!category || !name || !duration)
+			continue;
+		const auto& eventName = name->String();
+		const auto microseconds = duration->Number();
+
+		if (category->String() == "Session" && eventName == "model_run")
+		{
+			++summary.Runs;
+			summary.RunMicroseconds += microseconds;
+			continue;
+		}
+		if (category->String() != "Node" || eventName.size() <= KernelSuffix.size()
+			|| eventName.compare(eventName.size() - KernelSuffix.size(), KernelSuffix.size(), KernelSuffix) != 0)
+			continue;
+
+		const auto nodeName = eventName.substr(0, eventName.size() - KernelSuffix.size());
+		const auto* args = event.Find("args");
+		const auto* opName = args ? args->Find("op_name") : nullptr;
+		const auto opType = opName ? opName->String() : std::string{ "?" };
+
+		auto& node = nodes[nodeName];
+		node.Name = nodeName;
+		node.OpType = opType;
+		++node.Calls;
+		node.Microseconds += microseconds;
+
+		auto& op = opTypes[opType];
+		op.Name = opType;
+		op.OpType = opType;
+		++op.Calls;
+		op.Microseconds += microseconds;
+
+		const auto* tid = event.Find("tid");
+		busy[tid ? static_cast<std::int64_t>(tid->Number()) : 0] += microseconds;
+		summary.KernelMicroseconds += microseconds;
+	}
+
+	summary.Nodes = SortedByTime(nodes);
+	summary.OpTypes = SortedByTime(opTypes);
+	for (const auto& [threadId, microseconds] : busy)
+	{
+		summary.Threads.push_back({ threadId, microseconds, summary.RunMicroseconds > 0 ? microseconds / summary.RunMicroseconds : 0.0 });
+	}
+	return summary;
+}
+
+Utils::ProfileSummary Utils::SummarizeProfile(const std::filesystem::path& profilePath)
+{
+	return SummarizeProfile(ReadJsonFile(profilePath));
+}
+
+// milliseconds per run, the profiles without model_run events (e.g. cut short) count as one run
+static double MillisecondsPerRun(double microseconds, const Utils::ProfileSummary& summary)
+{
+	return microseconds / 1000.0 / std::max<size_t>(summary.Runs, 1);
+}
+
+static double Percent(double part, double total)
+{
+	return total > 0 ? 100.0 * part / total : 0.0;
+}
+
+void Utils::PrintProfile(std::ostream& os, const ProfileSummary& summary, size_t topNodes)
+{
+	const auto flags = os.flags();
+	const auto precision = os.precision();
+	os << std::fixed << std::setprecision(3);
+
+	os << summary.Runs << " runs, " << MillisecondsPerRun(summary.RunMicroseconds, summary) << " ms per run, "
+		<< MillisecondsPerRun(summary.KernelMicroseconds, summary) << " ms in kernels\n";
+
+	os << std::left << std::setw(40) << "node" << std::setw(20) << "op type" << std::right << std::setw(8) << "calls" << std::setw(12) << "ms/run" << std::setw(9) << "share" << "\n";
+	for (size_t i = 0; i < std::min(topNodes, summary.Nodes.size()); ++i)
+	{
+		const auto& node = summary.Nodes[i];
+		os << std::left << std::setw(40) << node.Name << std::setw(20) << node.OpType << std::right << std::setw(8) << node.Calls
+			<< std::setw(12) << MillisecondsPerRun(node.Microseconds, summary) << std::setw(8) << std::setprecision(1) << Percent(node.Microseconds, summary.KernelMicroseconds) << "%\n" << std::setprecision(3);
+	}
+
+	os << "\n" << std::left << std::setw(20) << "op type" << std::right << std::setw(8) << "calls" << std::setw(12) << "ms/run" << std::setw(9) << "share" << "\n";
+	for (const auto& op : summary.OpTypes)
+	{
+		os << std::left << std::setw(20) << op.Name << std::right << std::setw(8) << op.Calls
+			<< std::setw(12) << MillisecondsPerRun(op.Microseconds, summary) << std::setw(8) << std::setprecision(1) << Percent(op.Microseconds, summary.KernelMicroseconds) << "%\n" << std::setprecision(3);
+	}
+
+	os << "\n" << std::setprecision(1);
+	for (const auto& thread : summary.Threads)
+	{
+		os << "thread " << thread.ThreadId << ": " << MillisecondsPerRun(thread.BusyMicroseconds, summary) << " ms/run busy, " << thread.Utilization * 100 << "% of the runs\n";
+	}
+
+	os.flags(flags);
+	os.precision(precision);
+}
+
+namespace
+{
+	// time per run of the same name in both profiles, missing on one side counts as 0
+	struct Change
+	{
+		std::string Name;
+		std::string OpType;
+		double Before = 0;
+		double After = 0;
+	};
+}
+
+static std::vector<Change> Changes(const std::vector<Utils::OperatorStats>& before, const Utils::ProfileSummary& beforeSummary, const std::vector<Utils::OperatorStats>& after, const Utils::ProfileSummary& afterSummary)
+{
+	std::map<std::string, Change> changes;
+	for (const auto& stats : before)
+	{
+		auto& change = changes[stats.Name];
+		change.Name = stats.Name;
+		change.OpType = stats.OpType;
+		change.Before = MillisecondsPerRun(stats.Microseconds, beforeSummary);
+	}
+	for (const auto& stats : after)
+	{
+		auto& change = changes[stats.Name];
+		change.Name = stats.Name;
+		change.OpType = stats.OpType;
+		change.After = MillisecondsPerRun(stats.Microseconds, afterSummary);
+	}
+
+	std::vector<Change> sorted;
+	for (auto& [name, change] : changes)
+		sorted.push_back(std::move(change));
+	std::sort(begin(sorted), end(sorted), [](const auto& a, const auto& b) {
+		return std::abs(a.After - a.Before) > std::abs(b.After - b.Before);
+	});
+	return sorted;
+}
+
+static void PrintChanges(std::ostream& os, const char* title, const std::vector<Change>& changes, size_t count)
+{
+	os << std::left << std::setw(40) << title << std::right << std::setw(12) << "before ms" << std::setw(12) << "after ms" << std::setw(12) << "delta ms" << std::setw(10) << "change" << "\n";
+	for (size_t i = 0; i < std::min(count, changes.size()); ++i)
+	{
+		const auto& change = changes[i];
+		os << std::left << std::setw(40) << change.Name << std::right << std::setw(12) << change.Before << std::setw(12) << change.After << std::setw(12) << change.After - change.Before;
+		if (change.Before > 0)
+			os << std::setw(9) << std::setprecision(1) << Percent(change.After - change.Before, change.Before) << "%" << std::setprecision(3);
+		else
+			os << std::setw(10) << "new";
+		os << "\n";
+	}
+}
+
+void Utils::PrintProfileDiff(std::ostream& os, const ProfileSummary& before, const ProfileSummary& after, size_t topNodes)
+{
+	const auto flags = os.flags();
+	const auto precision = os.precision();
+	os << std::fixed << std::setprecision(3);
+
+	const auto runBefore = MillisecondsPerRun(before.RunMicroseconds, before);
+	const auto runAfter = MillisecondsPerRun(after.RunMicroseconds, after);
+	os << "per run: " << runBefore << " ms -> " << runAfter << " ms, kernels: " << MillisecondsPerRun(before.KernelMicroseconds, before)
+		<< " ms -> " << MillisecondsPerRun(after.KernelMicroseconds, after) << " ms\n";
+
+	const auto opTypes = Changes(before.OpTypes, before, after.OpTypes, after);
+	PrintChanges(os, "op type", opTypes, opTypes.size());
+	os << "\n";
+	PrintChanges(os, "node", Changes(before.Nodes, before, after.Nodes, after), topNodes);
+
+	os.flags(flags);
+	os.precision(precision);
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <iosfwd>
+#include <string>
+#include <vector>
+#include "Json.h"
+
+namespace Utils
+{
+	// kernel time of one node of the graph, or of all the nodes of one op type
+	struct OperatorStats
+	{
+		std::string Name;
+		std::string OpType;
+		size_t Calls = 0;
+		double Microseconds = 0;
+	};
+
+	// kernel time of one thread over the time of the runs
+	struct ThreadUtilization
+	{
+		std::int64_t ThreadId = 0;
+		double BusyMicroseconds = 0;
+		double Utilization = 0;
+	};
+
+	// the kernel events of an ORT profile grouped by node and by op type, both sorted by decreasing time
+	struct ProfileSummary
+	{
+		size_t Runs = 0;
+		// sum of the model_run events, the kernels plus the overhead of the session
+		double RunMicroseconds = 0;
+		double KernelMicroseconds = 0;
+		std::vector<OperatorStats> Nodes;
+		std::vector<OperatorStats> OpTypes;
+		// only the threads that run kernels: the workers of the intra-op pool show up only in the ORT versions that report them
+		std::vector<ThreadUtilization> Threads;
+	};
+
+	ProfileSummary SummarizeProfile(const JsonValue& profile);
+	ProfileSummary SummarizeProfile(const std::filesystem::path& profilePath);
+
+	// the heaviest nodes, every op type with its share of the kernel time, then the utilization of each thread
+	void PrintProfile(std::ostream& os, const ProfileSummary& summary, size_t topNodes = 20);
+	// time per run of each op type and of the nodes that changed most, ordered by the size of the change:
+	// profiles of a different number of runs compare fine
+	void PrintProfileDiff(std::ostream& os, const ProfileSummary& before, const ProfileSummary& after, size_t topNodes = 20);
+}
@@ -1,73 +1,255 @@
 #include "ResNet.h"
 #include <onnxruntime_cxx_api.h>
 #include <onnxruntime_c_api.h>
-#include <xtensor/xarray.hpp>
-#include <xtensor/xadapt.hpp>
-#include <xtensor/xmanipulation.hpp>
-#include <xtensor/xview.hpp>
 #include "Utils.h"
-#include <chrono>
+#include "ModelRegistry.h"
+#include "MicroBatcher.h"
+#include "SteadyStateSession.h"
+#include "Preprocessing.h"
+#include "WritableTensor.h"
+#include "Instrumentation.h"
+#include "ProfileReport.h"
+#include <array>
 
 using namespace std;
 
 static const int ImageWidth = 224;
 static const int ImageHeight = 224;
 
-auto PreprocessImageForResNet(const cv::Mat& frame)
+static const std::array<float, 3> Mean = { 0.485f, 0.456f, 0.406f };
+static const std::array<float, 3> Std = { 0.229f, 0.224f, 0.225f };
+
+size_t ResNet::InputSize()
+{
+	return 3 * ImageWidth * ImageHeight;
+}
+
+void ResNet::PreprocessInto(const cv::Mat& frame, Utils::span<float> dst, Utils::SimdLevel level)
 {
-	auto mat = Utils::ResizeToFloat(frame, { ImageWidth, ImageHeight });
-	xt::xarray<float> tens = xt::adapt(reinterpret_cast<float*>(mat.data), { 1, ImageWidth, ImageHeight, 3 });
-	tens = xt::transpose(std::move(tens), { 0, 3, 1, 2 });
+	// norm_data[:,c,:,:] = (img_data[:,:,:,c] / 255 - mean_vec[c])/std_vec[c], folded into one multiply-add
+	static const auto normalization = Utils::ChannelNormalization::FromMeanStd(1.0f / 255.0f, 0.0f, Mean, Std);
+	Utils::ResizeNormalizeToPlanar(frame, { ImageWidth, ImageHeight }, normalization, dst, level);
+}
 
-	xt::xarray<float> mean_vec{ 0.485f, 0.456f, 0.406f };
-	xt::xarray<float> std_vec{ 0.229f, 0.224f, 0.225f };
-	xt::xarray<float> norm_data = xt::zeros<float>({ 1, 3, ImageWidth, ImageHeight });
+std::vector<std::vector<Utils::Classification>> ResNet::ClassifyBatch(Utils::Model& model, Utils::span<const cv::Mat> images, const std::vector<std::string>& classes, size_t topK)
+{
+	// models exported with a fixed batch size are fed a zero-padded batch (e.g. the final partial one)
+	const auto modelBatch = model.Inputs[0].Shape[0];
+	const auto batch = images.size();
+	if (modelBatch > 0 && batch > static_cast<size_t>(modelBatch))
+	{
+		throw std::invalid_argument("batch is larger than the one supported by the model");
+	}
+	const auto runBatch = modelBatch > 0 ? static_cast<size_t>(modelBatch) : batch;
 
-	for (ptrdiff_t i = 0; i < 3; ++i)
+	// the images are preprocessed straight into the memory of the tensor, reused from one batch to the next
+	thread_local Utils::TensorArena arena;
+	auto input = arena.Tensor({ static_cast<int64_t>(runBatch), 3, ImageHeight, ImageWidth });
 	{
-		//    norm_data[:,i,:,:]                            = (img_data[:,i,:,:] - mean_vec[i])/std_vec[i]
-		view(norm_data, xt::all(), i, xt::all(), xt::all()) = (view(tens, xt::all(), i, xt::all(), xt::all()) - mean_vec[i]) / std_vec[i];
+		Utils::ScopeTimer timer{ Utils::Stage::Preprocess };
+		for (auto i = 0u; i < batch; ++i)
+		{
+			PreprocessInto(images[i], input.Data.subspan(i * InputSize(), InputSize()));
+		}
+		std::fill(input.Data.begin() + batch * InputSize(), input.Data.end(), 0.0f);
 	}
 
-	return norm_data;
+	auto onnxOutputTensor = [&] {
+		Utils::ScopeTimer timer{ Utils::Stage::Run };
+		return model.Run(&input.Value, 1);
+	}();
+	
+	// the [N,1000] output has one row per image, the padding rows are skipped
+	Utils::ScopeTimer timer{ Utils::Stage::Postprocess };
+	const auto output = Utils::AsSpan(onnxOutputTensor[0]);
+	const auto classesCount = output.size() / runBatch;
+	return Utils::TopKBatch(output.first(batch * classesCount), classesCount, classes, topK);
 }
 
-void Demo::RunResNet()
+void Demo::RunResNet(bool steadyState)
 {
-	Ort::Env env;
-	Ort::Session session{ env, LR"(data\resnet50v2.onnx)", Ort::SessionOptions{} };
-	auto memoryInfo = Ort::MemoryInfo::CreateCpu(OrtDeviceAllocator, OrtMemTypeCPU);
+	auto& model = Utils::ModelRegistry::Instance().Get(LR"(data\resnet50v2.onnx)");
 
 	// classes for inference
 	const auto classes = Utils::ReadClasses(R"(data\ImagenetClasses.txt)");
 
-	std::vector inputNames = Utils::OnnxGetInputNames(session);
-	std::vector outputNames = Utils::OnnxGetOutputNames(session);
+	auto& profiler = Utils::StageProfiler::Instance();
+	profiler.Reset();
+
+	if (steadyState)
+	{
+		// input and output tensors are allocated and bound only once
+		Utils::SteadyStateSession session{ model };
+		const auto input = session.Input();
+		const auto output = session.Output();
+
+		Utils::ForEachImage(".jpg", "data", [&](cv::Mat& image, const auto& imagePath) {
+			{
+				Utils::ScopeTimer timer{ Utils::Stage::Preprocess };
+				ResNet::PreprocessInto(image, input);
+			}
+			{
+				Utils::ScopeTimer timer{ Utils::Stage::Run };
+				session.Run();
+			}
+			const auto best = [&] {
+				Utils::ScopeTimer timer{ Utils::Stage::Postprocess };
+				return Utils::TopK(output, classes, 1)[0];
+			}();
+			cout << imagePath << " class: " << best.Label << " with % " << best.Probability * 100 << "\n";
+		});
+		profiler.Print(cout);
+		return;
+	}
 
-	const auto inputsAsConstCharPtr = Utils::MakeConstCharPtrVector(inputNames);
-	const auto outputsAsConstCharPtr = Utils::MakeConstCharPtrVector(outputNames);
-	
 	// iterate over the .jpg contained in the input folder
 	Utils::ForEachImage(".jpg", "data", [&](cv::Mat& image, const auto& imagePath) {
 
-		// PreprocessImageForResNet data and return an xtensor-specific tensor
-		auto inputTensor = PreprocessImageForResNet(image);
-		std::vector<int64_t> inputShape(inputTensor.shape().begin(), inputTensor.shape().end());
-		auto onnxInputTensor = Ort::Value::CreateTensor<float>(memoryInfo, 
-			inputTensor.data(), inputTensor.size(), 
-			inputShape.data(), inputShape.size());
-
-		const auto tic = std::chrono::system_clock::now();
-		auto onnxOutputTensor = session.Run(Ort::RunOptions{ nullptr },
-			inputsAsConstCharPtr.data(), &onnxInputTensor, inputsAsConstCharPtr.size(), 
-			outputsAsConstCharPtr.data(), outputsAsConstCharPtr.size());
-		std::cout << "inference elapsed: " << chrono::duration_cast<chrono::milliseconds>(std::chrono::system_clock::now() - tic).count() << "\n";
-		
-		auto outputTensor = Utils::AsSpan(onnxOutputTensor[0]);
+		// a fresh tensor from the allocator of ORT for each frame, the preprocessing writes directly into it
+		auto input = [&] {
+			Utils::ScopeTimer timer{ Utils::Stage::Preprocess };
+			auto tensor = Utils::AllocateInput(model);
+			ResNet::PreprocessInto(image, tensor.Data);
+			return tensor;
+		}();
+
+		auto onnxOutputTensor = [&] {
+			Utils::ScopeTimer timer{ Utils::Stage::Run };
+			return model.Run(&input.Value, 1);
+		}();
 		
-		Utils::softmax(outputTensor);
+		const auto best = [&] {
+			Utils::ScopeTimer timer{ Utils::Stage::Postprocess };
+			return Utils::TopK(Utils::AsSpan(onnxOutputTensor[0]), classes, 1)[0];
+		}();
+		cout << imagePath << " class: " << best.Label << " with % " << best.Probability * 100 << "\n";
+	});
+	profiler.Print(cout);
+}
+
+void Demo::RunResNetBatched(size_t batchSize)
+{
+	auto& model = Utils::ModelRegistry::Instance().Get(LR"(data\resnet50v2.onnx)");
+	const auto classes = Utils::ReadClasses(R"(data\ImagenetClasses.txt)");
+	Utils::StageProfiler::Instance().Reset();
+
+	std::vector<cv::Mat> images;
+	std::vector<std::filesystem::path> paths;
+	
+	const auto flush = [&] {
+		if (images.empty())
+			return;
+		const auto results = ResNet::ClassifyBatch(model, images, classes, 1);
+		for (auto i = 0u; i < results.size(); ++i)
+		{
+			cout << paths[i] << " class: " << results[i][0].Label << " with % " << results[i][0].Probability * 100 << "\n";
+		}
+		images.clear();
+		paths.clear();
+	};
 
-		const auto idx = distance(begin(outputTensor), max_element(begin(outputTensor), end(outputTensor)));
-		cout << imagePath << " class: " << classes[idx] << " with % " << outputTensor[idx] * 100 << "\n";
+	// collect batchSize images at a time, the last batch might be partial
+	Utils::ForEachImage(".jpg", "data", [&](cv::Mat& image, const auto& imagePath) {
+		images.push_back(std::move(image));
+		paths.push_back(imagePath);
+		if (images.size() == batchSize)
+			flush();
 	});
-}
\ No newline at end of file
+	flush();
+	Utils::StageProfiler::Instance().Print(cout);
+}
+
+void Demo::RunResNetMicroBatched(size_t maxBatch, std::chrono::microseconds deadline, size_t clients)
+{
+	auto& model = Utils::ModelRegistry::Instance().Get(LR"(data\resnet50v2.onnx)");
+	const auto classes = Utils::ReadClasses(R"(data\ImagenetClasses.txt)");
+	Utils::StageProfiler::Instance().Reset();
+
+	Utils::MicroBatcher<cv::Mat, Utils::Classification> batcher([&](std::vector<cv::Mat>& images) {
+		const auto topK = ResNet::ClassifyBatch(model, images, classes, 1);
+		std::vector<Utils::Classification> best;
+		best.reserve(topK.size());
+		for (const auto& classifications : topK)
+		{
+			best.push_back(classifications[0]);
+		}
+		return best;
+	}, maxBatch, deadline);
+
+	std::vector<std::filesystem::path> paths;
+	for (auto& p : std::filesystem::directory_iterator("data"))
+	{
+		if (p.is_regular_file() && p.path().extension() == ".jpg")
+			paths.push_back(p.path());
+	}
+
+	// each client sends its images one at a time, waiting for the answer before sending the next one
+	std::mutex coutMutex;
+	std::vector<std::thread> threads;
+	{
+		Utils::defer_join_all guard{ threads };
+		for (size_t client = 0; client < clients; ++client)
+		{
+			threads.emplace_back([&, client] {
+				for (auto i = client; i < paths.size(); i += clients)
+				{
+					try
+					{
+						// an image that cannot be read would fail the whole batch, the requests of the other clients with it
+						auto image = Utils::ReadImage(paths[i]);
+						if (image.empty())
+						{
+							std::lock_guard lock{ coutMutex };
+							cout << "cannot read " << paths[i].string() << "\n";
+							continue;
+						}
+						const auto result = batcher.Submit(std::move(image)).get();
+						std::lock_guard lock{ coutMutex };
+						cout << paths[i] << " class: " << result.Label << " with % " << result.Probability * 100 << "\n";
+					}
+					catch (const exception& ex)
+					{
+						std::lock_guard lock{ coutMutex };
+						cout << ex.what() << "\n";
+					}
+				}
+			});
+		}
+	}
+
+	batcher.BatchSizes().Print(cout, "batch size", "");
+	batcher.QueueWaits().Print(cout, "queue wait", "us");
+	Utils::StageProfiler::Instance().Print(cout);
+}
+
+std::filesystem::path Demo::ProfileResNet(const Ort::SessionOptions& options)
+{
+	// not from the registry: it would return the session already loaded whatever the options
+	auto sessionOptions = options.Clone();
+	sessionOptions.EnableProfiling(ORT_TSTR("ort_profile_resnet50v2"));
+	Utils::Model model{ Utils::ModelRegistry::Instance().Env(), LR"(data\resnet50v2.onnx)", sessionOptions };
+
+	Utils::ForEachImage(".jpg", "data", [&](cv::Mat& image, const auto&) {
+		auto input = Utils::AllocateInput(model);
+		ResNet::PreprocessInto(image, input.Data);
+		model.Run(&input.Value, 1);
+	});
+	return Utils::OnnxEndProfiling(model.Session);
+}
+
+void Demo::CompareResNetProfiles()
+{
+	Ort::SessionOptions basic;
+	basic.SetGraphOptimizationLevel(GraphOptimizationLevel::ORT_ENABLE_BASIC);
+	Ort::SessionOptions all;
+	all.SetGraphOptimizationLevel(GraphOptimizationLevel::ORT_ENABLE_ALL);
+
+	const auto before = Utils::SummarizeProfile(ProfileResNet(basic));
+	const auto after = Utils::SummarizeProfile(ProfileResNet(all));
+	cout << "basic optimizations\n";
+	Utils::PrintProfile(cout, before);
+	cout << "\nall optimizations\n";
+	Utils::PrintProfile(cout, after);
+	cout << "\nbasic -> all\n";
+	Utils::PrintProfileDiff(cout, before, after);
+}
@@ -1,6 +1,42 @@
 #pragma once
+#include <opencv2/core/mat.hpp>
+#include <chrono>
+#include <filesystem>
+#include "Classification.h"
+#include "CpuFeatures.h"
+
+namespace Ort
+{
+	struct SessionOptions;
+}
+
+namespace Utils
+{
+	class Model;
+}
+
+namespace ResNet
+{
+	// number of floats written by PreprocessInto (3x224x224)
+	size_t InputSize();
+
+	// resizes, normalizes and writes the image as planar CHW into dst (e.g. a slot of a batch tensor)
+	void PreprocessInto(const cv::Mat& frame, Utils::span<float> dst, Utils::SimdLevel level = Utils::BestSimdLevel());
+
+	// preprocesses all the images into a single [N,3,224,224] tensor, runs once and returns the topK classes of each image
+	std::vector<std::vector<Utils::Classification>> ClassifyBatch(Utils::Model& model, Utils::span<const cv::Mat> images, const std::vector<std::string>& classes, size_t topK);
+}
 
 namespace Demo
 {
-	void RunResNet();
+	// in steady state mode the tensors are allocated once and bound to the session
+	void RunResNet(bool steadyState = true);
+	void RunResNetBatched(size_t batchSize = 16);
+	// several clients classify images one by one, a micro-batcher groups their requests
+	void RunResNetMicroBatched(size_t maxBatch = 8, std::chrono::microseconds deadline = std::chrono::milliseconds{ 2 }, size_t clients = 4);
+
+	// classifies the images of data with a new profiling session of ResNet built with options, returns the profile ORT wrote
+	std::filesystem::path ProfileResNet(const Ort::SessionOptions& options);
+	// profiles ResNet with the basic and with all the graph optimizations, prints both profiles and what changed
+	void CompareResNetProfiles();
 }
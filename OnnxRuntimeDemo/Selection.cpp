@@ -0,0 +1,74 @@
+#include "Selection.h"
+#include <immintrin.h>
+
+static void SelectAboveScalar(const float* values, std::uint32_t begin, std::uint32_t end, float threshold, std::vector<std::uint32_t>& indices)
+{
+	for (auto i = begin; i < end; ++i)
+	{
+		if (values[i] > threshold)
+		{
+			indices.push_back(i);
+		}
+	}
+}
+
+UTILS_TARGET("avx2")
+static void SelectAboveAvx2(const float* values, std::uint32_t count, float threshold, std::vector<std::uint32_t>& indices)
+{
+	const auto limit = _mm256_set1_ps(threshold);
+	auto i = 0u;
+	for (; i + 32 <= count; i += 32)
+	{
+		// 32 comparisons packed into one word: the loop over the survivors is skipped for most blocks
+		std::uint64_t mask = 0;
+		for (auto k = 0u; k < 4; ++k)
+		{
+			const auto above = _mm256_cmp_ps(_mm256_loadu_ps(values + i + k * 8), limit, _CMP_GT_OQ);
+			mask |= static_cast<std::uint64_t>(static_cast<std::uint32_t>(_mm256_movemask_ps(above))) << (k * 8);
+		}
+		for (; mask != 0; mask &= mask - 1)
+		{
+			indices.push_back(i + Utils::CountTrailingZeros(mask));
+		}
+	}
+	SelectAboveScalar(values, i, count, threshold, indices);
+}
+
+UTILS_TARGET("avx512f")
+static void SelectAboveAvx512(const float* values, std::uint32_t count, float threshold, std::vector<std::uint32_t>& indices)
+{
+	const auto limit = _mm512_set1_ps(threshold);
+	const auto step = _mm512_set1_epi32(16);
+	auto lanes = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+	for (auto i = 0u; i < count; i += 16)
+	{
+		const auto valid = static_cast<__mmask16>(count - i >= 16 ? 0xffff : (1u << (count - i)) - 1);
+		const auto above = _mm512_mask_cmp_ps_mask(valid, _mm512_maskz_loadu_ps(valid, values + i), limit, _CMP_GT_OQ);
+		if (above != 0)
+		{
+			// the indices of the lanes that pass are packed to the front and stored in one go
+			const auto size = indices.size();
+			const auto survivors = static_cast<size_t>(_mm_popcnt_u32(above));
+			indices.resize(size + survivors);
+			_mm512_mask_compressstoreu_epi32(indices.data() + size, above, lanes);
+		}
+		lanes = _mm512_add_epi32(lanes, step);
+	}
+}
+
+void Utils::SelectAbove(span<const float> values, float threshold, std::vector<std::uint32_t>& indices, SimdLevel level)
+{
+	const auto count = static_cast<std::uint32_t>(values.size());
+	switch (level)
+	{
+	case SimdLevel::Avx2:
+		SelectAboveAvx2(values.data(), count, threshold, indices);
+		break;
+	case SimdLevel::Avx512:
+		SelectAboveAvx512(values.data(), count, threshold, indices);
+		break;
+	default:
+		SelectAboveScalar(values.data(), 0, count, threshold, indices);
+		break;
+	}
+}
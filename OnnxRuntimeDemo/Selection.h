@@ -0,0 +1,13 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "span.h"
+#include "CpuFeatures.h"
+
+namespace Utils
+{
+	// appends to indices the index of every value above threshold, in increasing order (indices is not cleared)
+	// a whole register is compared at once and only the lanes that pass are written out: the cost is the scan,
+	// not the number of survivors
+	void SelectAbove(span<const float> values, float threshold, std::vector<std::uint32_t>& indices, SimdLevel level = BestSimdLevel());
+}
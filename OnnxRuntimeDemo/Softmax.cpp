@@ -0,0 +1,373 @@
+#include "Softmax.h"
+#include "Selection.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <immintrin.h>
+
+// Cephes expf: exp(x) = 2^n * exp(r) with n = round(x / ln2) and |r| <= ln2 / 2
+// inputs are clamped so that 2^n stays a normal float (softmax only needs x <= 0)
+static const float ExpLow = -87.3365478515625f;
+static const float ExpHigh = 88.3762626647949f;
+static const float Log2e = 1.44269504088896341f;
+static const float Ln2Hi = 0.693359375f;
+static const float Ln2Lo = -2.12194440e-4f;
+static const float P0 = 1.9875691500e-4f;
+static const float P1 = 1.3981999507e-3f;
+static const float P2 = 8.3334519073e-3f;
+static const float P3 = 4.1665795894e-2f;
+static const float P4 = 1.6666665459e-1f;
+static const float P5 = 5.0000001201e-1f;
+
+static float ExpPolynomial(float x)
+{
+	x = std::min(std::max(x, ExpLow), ExpHigh);
+	const auto n = std::nearbyint(x * Log2e);
+	auto r = x - n * Ln2Hi;
+	r = r - n * Ln2Lo;
+	auto p = P0;
+	p = p * r + P1;
+	p = p * r + P2;
+	p = p * r + P3;
+	p = p * r + P4;
+	p = p * r + P5;
+	p = p * r * r + r + 1.0f;
+	const auto bits = static_cast<std::uint32_t>(static_cast<std::int32_t>(n) + 127) << 23;
+	float pow2n;
+	std::memcpy(&pow2n, &bits, sizeof(pow2n));
+	return p * pow2n;
+}
+
+static float Exp(float x, bool fast)
+{
+	return fast ? ExpPolynomial(x) : std::exp(x);
+}
+
+// writes exp(row[i] - max) and returns their sum, from begin to count
+static float ExpSumScalar(float* row, size_t begin, size_t count, float max, bool fast)
+{
+	auto sum = 0.0f;
+	for (auto i = begin; i < count; ++i)
+	{
+		row[i] = Exp(row[i] - max, fast);
+		sum += row[i];
+	}
+	return sum;
+}
+
+static float MaxScalar(const float* row, size_t count)
+{
+	return *std::max_element(row, row + count);
+}
+
+static float SumExpScalar(const float* row, size_t count, float max, bool fast)
+{
+	auto sum = 0.0f;
+	for (auto i = 0u; i < count; ++i)
+	{
+		sum += Exp(row[i] - max, fast);
+	}
+	return sum;
+}
+
+static void SoftmaxRowScalar(float* row, size_t count, bool fast)
+{
+	const auto max = MaxScalar(row, count);
+	const auto inverseSum = 1.0f / ExpSumScalar(row, 0, count, max, fast);
+	for (auto i = 0u; i < count; ++i)
+	{
+		row[i] *= inverseSum;
+	}
+}
+
+UTILS_TARGET("avx2")
+static inline __m256 ExpPolynomial(__m256 x)
+{
+	x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(ExpLow)), _mm256_set1_ps(ExpHigh));
+	const auto n = _mm256_round_ps(_mm256_mul_ps(x, _mm256_set1_ps(Log2e)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+	auto r = _mm256_sub_ps(x, _mm256_mul_ps(n, _mm256_set1_ps(Ln2Hi)));
+	r = _mm256_sub_ps(r, _mm256_mul_ps(n, _mm256_set1_ps(Ln2Lo)));
+	auto p = _mm256_set1_ps(P0);
+	p = _mm256_add_ps(_mm256_mul_ps(p, r), _mm256_set1_ps(P1));
+	p = _mm256_add_ps(_mm256_mul_ps(p, r), _mm256_set1_ps(P2));
+	p = _mm256_add_ps(_mm256_mul_ps(p, r), _mm256_set1_ps(P3));
+	p = _mm256_add_ps(_mm256_mul_ps(p, r), _mm256_set1_ps(P4));
+	p = _mm256_add_ps(_mm256_mul_ps(p, r), _mm256_set1_ps(P5));
+	p = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(p, r), r), r), _mm256_set1_ps(1.0f));
+	const auto pow2n = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(n), _mm256_set1_epi32(127)), 23));
+	return _mm256_mul_ps(p, pow2n);
+}
+
+UTILS_TARGET("avx2")
+static inline float HorizontalMax(__m256 v)
+{
+	auto m = _mm_max_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+	m = _mm_max_ps(m, _mm_movehl_ps(m, m));
+	m = _mm_max_ss(m, _mm_movehdup_ps(m));
+	return _mm_cvtss_f32(m);
+}
+
+UTILS_TARGET("avx2")
+static inline float HorizontalSum(__m256 v)
+{
+	auto s = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+	s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+	s = _mm_add_ss(s, _mm_movehdup_ps(s));
+	return _mm_cvtss_f32(s);
+}
+
+UTILS_TARGET("avx2")
+static float MaxAvx2(const float* row, size_t count)
+{
+	const auto vectorEnd = count - count % 8;
+	auto vmax = _mm256_set1_ps(-std::numeric_limits<float>::infinity());
+	for (auto i = 0u; i < vectorEnd; i += 8)
+	{
+		vmax = _mm256_max_ps(vmax, _mm256_loadu_ps(row + i));
+	}
+	auto max = HorizontalMax(vmax);
+	for (auto i = vectorEnd; i < count; ++i)
+	{
+		max = std::max(max, row[i]);
+	}
+	return max;
+}
+
+UTILS_TARGET("avx2")
+static float SumExpAvx2(const float* row, size_t count, float max, bool fast)
+{
+	if (!fast)
+		return SumExpScalar(row, count, max, false);
+
+	const auto vectorEnd = count - count % 8;
+	const auto broadcastMax = _mm256_set1_ps(max);
+	auto vsum = _mm256_setzero_ps();
+	for (auto i = 0u; i < vectorEnd; i += 8)
+	{
+		vsum = _mm256_add_ps(vsum, ExpPolynomial(_mm256_sub_ps(_mm256_loadu_ps(row + i), broadcastMax)));
+	}
+	return HorizontalSum(vsum) + SumExpScalar(row + vectorEnd, count - vectorEnd, max, true);
+}
+
+UTILS_TARGET("avx2")
+static void SoftmaxRowAvx2(float* row, size_t count, bool fast)
+{
+	const auto vectorEnd = count - count % 8;
+	const auto max = MaxAvx2(row, count);
+
+	float sum;
+	if (fast)
+	{
+		const auto broadcastMax = _mm256_set1_ps(max);
+		auto vsum = _mm256_setzero_ps();
+		for (auto i = 0u; i < vectorEnd; i += 8)
+		{
+			const auto e = ExpPolynomial(_mm256_sub_ps(_mm256_loadu_ps(row + i), broadcastMax));
+			_mm256_storeu_ps(row + i, e);
+			vsum = _mm256_add_ps(vsum, e);
+		}
+		sum = HorizontalSum(vsum) + ExpSumScalar(row, vectorEnd, count, max, true);
+	}
+	else
+	{
+		sum = ExpSumScalar(row, 0, count, max, false);
+	}
+
+	const auto inverseSum = 1.0f / sum;
+	const auto broadcastInverseSum = _mm256_set1_ps(inverseSum);
+	for (auto i = 0u; i < vectorEnd; i += 8)
+	{
+		_mm256_storeu_ps(row + i, _mm256_mul_ps(_mm256_loadu_ps(row + i), broadcastInverseSum));
+	}
+	for (auto i = vectorEnd; i < count; ++i)
+	{
+		row[i] *= inverseSum;
+	}
+}
+
+UTILS_TARGET("avx512f")
+static inline __m512 ExpPolynomial(__m512 x)
+{
+	x = _mm512_min_ps(_mm512_max_ps(x, _mm512_set1_ps(ExpLow)), _mm512_set1_ps(ExpHigh));
+	const auto n = _mm512_roundscale_ps(_mm512_mul_ps(x, _mm512_set1_ps(Log2e)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+	auto r = _mm512_sub_ps(x, _mm512_mul_ps(n, _mm512_set1_ps(Ln2Hi)));
+	r = _mm512_sub_ps(r, _mm512_mul_ps(n, _mm512_set1_ps(Ln2Lo)));
+	auto p = _mm512_set1_ps(P0);
+	p = _mm512_add_ps(_mm512_mul_ps(p, r), _mm512_set1_ps(P1));
+	p = _mm512_add_ps(_mm512_mul_ps(p, r), _mm512_set1_ps(P2));
+	p = _mm512_add_ps(_mm512_mul_ps(p, r), _mm512_set1_ps(P3));
+	p = _mm512_add_ps(_mm512_mul_ps(p, r), _mm512_set1_ps(P4));
+	p = _mm512_add_ps(_mm512_mul_ps(p, r), _mm512_set1_ps(P5));
+	p = _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(_mm512_mul_ps(p, r), r), r), _mm512_set1_ps(1.0f));
+	const auto pow2n = _mm512_castsi512_ps(_mm512_slli_epi32(_mm512_add_epi32(_mm512_cvtps_epi32(n), _mm512_set1_epi32(127)), 23));
+	return _mm512_mul_ps(p, pow2n);
+}
+
+UTILS_TARGET("avx512f")
+static float MaxAvx512(const float* row, size_t count)
+{
+	const auto vectorEnd = count - count % 16;
+	const auto tailMask = static_cast<__mmask16>((1u << (count % 16)) - 1);
+	const auto lowest = _mm512_set1_ps(-std::numeric_limits<float>::infinity());
+	auto vmax = lowest;
+	for (auto i = 0u; i < vectorEnd; i += 16)
+	{
+		vmax = _mm512_max_ps(vmax, _mm512_loadu_ps(row + i));
+	}
+	vmax = _mm512_max_ps(vmax, _mm512_mask_loadu_ps(lowest, tailMask, row + vectorEnd));
+	return _mm512_reduce_max_ps(vmax);
+}
+
+UTILS_TARGET("avx512f")
+static float SumExpAvx512(const float* row, size_t count, float max, bool fast)
+{
+	if (!fast)
+		return SumExpScalar(row, count, max, false);
+
+	const auto vectorEnd = count - count % 16;
+	const auto tailMask = static_cast<__mmask16>((1u << (count % 16)) - 1);
+	const auto broadcastMax = _mm512_set1_ps(max);
+	auto vsum = _mm512_setzero_ps();
+	for (auto i = 0u; i < vectorEnd; i += 16)
+	{
+		vsum = _mm512_add_ps(vsum, ExpPolynomial(_mm512_sub_ps(_mm512_loadu_ps(row + i), broadcastMax)));
+	}
+	const auto e = ExpPolynomial(_mm512_sub_ps(_mm512_maskz_loadu_ps(tailMask, row + vectorEnd), broadcastMax));
+	vsum = _mm512_mask_add_ps(vsum, tailMask, vsum, e);
+	return _mm512_reduce_add_ps(vsum);
+}
+
+// the tail is handled with masked loads and stores: 91 classes are 5 full registers and one of 11 lanes
+UTILS_TARGET("avx512f")
+static void SoftmaxRowAvx512(float* row, size_t count, bool fast)
+{
+	const auto vectorEnd = count - count % 16;
+	const auto tailMask = static_cast<__mmask16>((1u << (count % 16)) - 1);
+	const auto max = MaxAvx512(row, count);
+
+	float sum;
+	if (fast)
+	{
+		const auto broadcastMax = _mm512_set1_ps(max);
+		auto vsum = _mm512_setzero_ps();
+		for (auto i = 0u; i < vectorEnd; i += 16)
+		{
+			const auto e = ExpPolynomial(_mm512_sub_ps(_mm512_loadu_ps(row + i), broadcastMax));
+			_mm512_storeu_ps(row + i, e);
+			vsum = _mm512_add_ps(vsum, e);
+		}
+		const auto e = ExpPolynomial(_mm512_sub_ps(_mm512_maskz_loadu_ps(tailMask, row + vectorEnd), broadcastMax));
+		_mm512_mask_storeu_ps(row + vectorEnd, tailMask, e);
+		vsum = _mm512_mask_add_ps(vsum, tailMask, vsum, e);
+		sum = _mm512_reduce_add_ps(vsum);
+	}
+	else
+	{
+		sum = ExpSumScalar(row, 0, count, max, false);
+	}
+
+	const auto inverseSum = _mm512_set1_ps(1.0f / sum);
+	for (auto i = 0u; i < vectorEnd; i += 16)
+	{
+		_mm512_storeu_ps(row + i, _mm512_mul_ps(_mm512_loadu_ps(row + i), inverseSum));
+	}
+	_mm512_mask_storeu_ps(row + vectorEnd, tailMask, _mm512_mul_ps(_mm512_maskz_loadu_ps(tailMask, row + vectorEnd), inverseSum));
+}
+
+using SoftmaxRowKernel = void(*)(float* row, size_t count, bool fast);
+
+static SoftmaxRowKernel GetSoftmaxRowKernel(Utils::SimdLevel level)
+{
+	switch (level)
+	{
+	case Utils::SimdLevel::Avx2: return SoftmaxRowAvx2;
+	case Utils::SimdLevel::Avx512: return SoftmaxRowAvx512;
+	default: return SoftmaxRowScalar;
+	}
+}
+
+struct LogSumExpKernels
+{
+	float(*Max)(const float* row, size_t count);
+	float(*SumExp)(const float* row, size_t count, float max, bool fast);
+};
+
+static LogSumExpKernels GetLogSumExpKernels(Utils::SimdLevel level)
+{
+	switch (level)
+	{
+	case Utils::SimdLevel::Avx2: return { MaxAvx2, SumExpAvx2 };
+	case Utils::SimdLevel::Avx512: return { MaxAvx512, SumExpAvx512 };
+	default: return { MaxScalar, SumExpScalar };
+	}
+}
+
+void Utils::Softmax(span<float> data, SoftmaxMode mode, SimdLevel level)
+{
+	if (data.empty())
+		return;
+	GetSoftmaxRowKernel(level)(data.data(), data.size(), mode == SoftmaxMode::Fast);
+}
+
+void Utils::SoftmaxRows(span<float> data, size_t cols, SoftmaxMode mode, SimdLevel level)
+{
+	if (cols == 0 || data.size() % cols != 0)
+	{
+		throw std::invalid_argument("SoftmaxRows: the size of data is not a multiple of cols");
+	}
+	const auto kernel = GetSoftmaxRowKernel(level);
+	const auto fast = mode == SoftmaxMode::Fast;
+	for (auto row = data.data(); row != data.data() + data.size(); row += cols)
+	{
+		kernel(row, cols, fast);
+	}
+}
+
+void Utils::SoftmaxRowsAbove(span<const float> data, size_t cols, float threshold, std::vector<RowProbability>& selected, size_t firstCol,
+	SoftmaxMode mode, SimdLevel level)
+{
+	if (cols == 0 || data.size() % cols != 0 || firstCol > cols)
+	{
+		throw std::invalid_argument("SoftmaxRowsAbove: the size of data is not a multiple of cols or firstCol is past cols");
+	}
+	const auto kernels = GetLogSumExpKernels(level);
+	const auto fast = mode == SoftmaxMode::Fast;
+	// exp(x - max) / sum > threshold needs x > max + log(threshold) + log(sum), and sum >= 1 (the max counts for 1):
+	// the row is compared against max + log(threshold), loosened to absorb the rounding of exp and log, and only
+	// the few entries above it get their exact probability
+	const auto logThreshold = threshold > 0 ? std::log(threshold) - 1e-3f : -std::numeric_limits<float>::infinity();
+	thread_local std::vector<std::uint32_t> above;
+
+	const auto rows = data.size() / cols;
+	for (auto r = 0u; r < rows; ++r)
+	{
+		const auto row = data.subspan(r * cols, cols);
+		const auto max = kernels.Max(row.data(), cols);
+		const auto sum = kernels.SumExp(row.data(), cols, max, fast);
+
+		above.clear();
+		SelectAbove(row.subspan(firstCol), max + logThreshold, above, level);
+		const auto inverseSum = 1.0f / sum;
+		for (const auto i : above)
+		{
+			const auto col = static_cast<std::uint32_t>(firstCol + i);
+			const auto probability = Exp(row[col] - max, fast) * inverseSum;
+			if (probability > threshold)
+			{
+				selected.push_back({ r, col, probability });
+			}
+		}
+	}
+}
+
+float Utils::LogSumExp(span<const float> data, SoftmaxMode mode, SimdLevel level)
+{
+	if (data.empty())
+		return -std::numeric_limits<float>::infinity();
+	const auto kernels = GetLogSumExpKernels(level);
+	const auto max = kernels.Max(data.data(), data.size());
+	return max + std::log(kernels.SumExp(data.data(), data.size(), max, mode == SoftmaxMode::Fast));
+}
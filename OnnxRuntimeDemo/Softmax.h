@@ -0,0 +1,39 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "span.h"
+#include "CpuFeatures.h"
+
+namespace Utils
+{
+	enum class SoftmaxMode
+	{
+		// std::exp on each element: the accuracy of the softmax template, only max and normalization are vectorized
+		Exact,
+		// exp evaluated with a degree 5 polynomial on whole registers: probabilities are within 5e-6 (relative) of Exact
+		Fast,
+	};
+
+	// in place, the same as softmax(data) with SIMD (AVX2 and AVX-512, SSE4.1 machines use the scalar path)
+	void Softmax(span<float> data, SoftmaxMode mode = SoftmaxMode::Exact, SimdLevel level = BestSimdLevel());
+
+	// data is a row-major [rows, cols] matrix (e.g. the [candidates, classes] scores of a detector), each row gets its own softmax
+	void SoftmaxRows(span<float> data, size_t cols, SoftmaxMode mode = SoftmaxMode::Exact, SimdLevel level = BestSimdLevel());
+
+	// an entry of a row-major matrix and its probability
+	struct RowProbability
+	{
+		std::uint32_t Row;
+		std::uint32_t Col;
+		float Probability;
+	};
+
+	// SoftmaxRows fused with a threshold, without writing data: appends to selected the entries whose probability is above
+	// threshold (the same probabilities as SoftmaxRows), row by row and column by column. The columns before firstCol
+	// (e.g. the background of a detector) are part of the softmax but never selected
+	void SoftmaxRowsAbove(span<const float> data, size_t cols, float threshold, std::vector<RowProbability>& selected, size_t firstCol = 0,
+		SoftmaxMode mode = SoftmaxMode::Exact, SimdLevel level = BestSimdLevel());
+
+	// log(sum(exp(data))) without writing anything: exp(x - LogSumExp(data)) is the probability of x
+	float LogSumExp(span<const float> data, SoftmaxMode mode = SoftmaxMode::Exact, SimdLevel level = BestSimdLevel());
+}
@@ -0,0 +1,31 @@
+#include "SsdPriors.h"
+
+static constexpr auto MobileNetPriors = Utils::MakeSsdPriors<Utils::CountSsdPriors(Utils::MobileNetSsdSpecs)>(Utils::MobileNetSsdSpecs, Utils::MobileNetSsdImageSize);
+
+Utils::SsdPriorsView Utils::MobileNetSsdPriors()
+{
+	return MobileNetPriors.View();
+}
+
+Utils::SsdPriors::SsdPriors(span<const SsdSpec> specs, float imageSize)
+{
+	size_t count = 0;
+	for (const auto& spec : specs)
+		count += static_cast<size_t>(spec.FeatureSize) * spec.FeatureSize * 6;
+	x.resize(count);
+	y.resize(count);
+	w.resize(count);
+	h.resize(count);
+
+	ForEachSsdPrior(specs.data(), specs.size(), imageSize, [&](size_t i, float px, float py, float pw, float ph) {
+		x[i] = px;
+		y[i] = py;
+		w[i] = pw;
+		h[i] = ph;
+	});
+}
+
+Utils::SsdPriorsView Utils::SsdPriors::View() const
+{
+	return { x, y, w, h };
+}
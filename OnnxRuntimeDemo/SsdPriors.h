@@ -0,0 +1,157 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <vector>
+#include "span.h"
+
+namespace Utils
+{
+	// one feature map of an SSD head: each cell has 6 priors (2 squares and 2 pairs of ratios)
+	struct SsdSpec
+	{
+		int FeatureSize = 0;
+		int Shrinkage = 0;
+		int BoxWidth = 0;
+		int BoxHeight = 0;
+		int Ratio1 = 0;
+		int Ratio2 = 0;
+	};
+
+	constexpr bool operator==(const SsdSpec& a, const SsdSpec& b)
+	{
+		return a.FeatureSize == b.FeatureSize && a.Shrinkage == b.Shrinkage && a.BoxWidth == b.BoxWidth && a.BoxHeight == b.BoxHeight
+			&& a.Ratio1 == b.Ratio1 && a.Ratio2 == b.Ratio2;
+	}
+
+	// the head of the MobileNet SSD of the demo, for 512x512 images
+	inline constexpr float MobileNetSsdImageSize = 512;
+	inline constexpr std::array<SsdSpec, 6> MobileNetSsdSpecs{ {
+		{ 32, 16, 60, 105, 2, 3 },
+		{ 16, 32, 105, 150, 2, 3 },
+		{ 8, 64, 150, 195, 2, 3 },
+		{ 4, 100, 195, 240, 2, 3 },
+		{ 2, 150, 240, 285, 2, 3 },
+		{ 1, 300, 285, 330, 2, 3 },
+	} };
+
+	// priors as a structure of arrays: center (X, Y) and size (W, H), relative to the image and clamped to [0, 1]
+	struct SsdPriorsView
+	{
+		span<const float> X;
+		span<const float> Y;
+		span<const float> W;
+		span<const float> H;
+
+		size_t Size() const { return X.size(); }
+	};
+
+	namespace Detail
+	{
+		// Newton iterations in double, rounded once to float: the same value as sqrtf for the few inputs of a spec table
+		constexpr float ConstexprSqrt(float value)
+		{
+			if (value <= 0)
+				return 0;
+			const double x = value;
+			double guess = x > 1 ? x : 1;
+			for (auto i = 0; i < 64; ++i)
+			{
+				const auto next = 0.5 * (guess + x / guess);
+				if (next == guess)
+					break;
+				guess = next;
+			}
+			return static_cast<float>(guess);
+		}
+	}
+
+	template <size_t Specs>
+	constexpr size_t CountSsdPriors(const std::array<SsdSpec, Specs>& specs)
+	{
+		size_t count = 0;
+		for (const auto& spec : specs)
+			count += static_cast<size_t>(spec.FeatureSize) * spec.FeatureSize * 6;
+		return count;
+	}
+
+	// calls emit(index, x, y, w, h) for each prior in the order of the outputs of the network:
+	// the same code fills the constexpr tables and the priors generated at run time
+	template <class Emit>
+	constexpr void ForEachSsdPrior(const SsdSpec* specs, size_t specCount, float imageSize, Emit&& emit)
+	{
+		size_t index = 0;
+		const auto add = [&](float x, float y, float w, float h) {
+			emit(index++, std::clamp(x, 0.0f, 1.0f), std::clamp(y, 0.0f, 1.0f), std::clamp(w, 0.0f, 1.0f), std::clamp(h, 0.0f, 1.0f));
+		};
+		for (size_t i = 0; i < specCount; i++)
+		{
+			const auto& spec = specs[i];
+			const float scale = imageSize / static_cast<float>(spec.Shrinkage);
+			const int min = spec.BoxHeight > spec.BoxWidth ? spec.BoxWidth : spec.BoxHeight;
+			const int max = spec.BoxHeight < spec.BoxWidth ? spec.BoxWidth : spec.BoxHeight;
+			const float small = min / imageSize;
+			const float big = Detail::ConstexprSqrt(static_cast<float>(max) * min) / imageSize;
+			const float ratio1 = Detail::ConstexprSqrt(static_cast<float>(spec.Ratio1));
+			const float ratio2 = Detail::ConstexprSqrt(static_cast<float>(spec.Ratio2));
+			for (int j = 0; j < spec.FeatureSize; j++)
+			{
+				for (int k = 0; k < spec.FeatureSize; k++)
+				{
+					const float x = (k + 0.5f) / scale;
+					const float y = (j + 0.5f) / scale;
+					// small and big squares, then the small one stretched by both ratios
+					add(x, y, small, small);
+					add(x, y, big, big);
+					add(x, y, small * ratio1, small / ratio1);
+					add(x, y, small / ratio1, small * ratio1);
+					add(x, y, small * ratio2, small / ratio2);
+					add(x, y, small / ratio2, small * ratio2);
+				}
+			}
+		}
+	}
+
+	// priors computed by the compiler, e.g. static constexpr auto priors = MakeSsdPriors<CountSsdPriors(specs)>(specs, 512);
+	template <size_t Count>
+	struct SsdPriorArrays
+	{
+		std::array<float, Count> X{};
+		std::array<float, Count> Y{};
+		std::array<float, Count> W{};
+		std::array<float, Count> H{};
+
+		SsdPriorsView View() const { return { X, Y, W, H }; }
+	};
+
+	template <size_t Count, size_t Specs>
+	constexpr SsdPriorArrays<Count> MakeSsdPriors(const std::array<SsdSpec, Specs>& specs, float imageSize)
+	{
+		SsdPriorArrays<Count> priors{};
+		ForEachSsdPrior(specs.data(), Specs, imageSize, [&](size_t i, float x, float y, float w, float h) {
+			priors.X[i] = x;
+			priors.Y[i] = y;
+			priors.W[i] = w;
+			priors.H[i] = h;
+		});
+		return priors;
+	}
+
+	// the priors of MobileNetSsdSpecs at MobileNetSsdImageSize, a read-only table computed at compile time
+	SsdPriorsView MobileNetSsdPriors();
+
+	// priors of any head, computed at run time by whoever needs them (e.g. the object of a model with another head)
+	class SsdPriors
+	{
+	public:
+		SsdPriors(span<const SsdSpec> specs, float imageSize);
+
+		SsdPriorsView View() const;
+
+	private:
+		std::vector<float> x;
+		std::vector<float> y;
+		std::vector<float> w;
+		std::vector<float> h;
+	};
+}
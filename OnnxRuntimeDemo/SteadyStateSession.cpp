@@ -0,0 +1,55 @@
+#include "SteadyStateSession.h"
+#include "ModelRegistry.h"
+#include "WritableTensor.h"
+
+static void AllocateTensors(const std::vector<Utils::TensorInfo>& infos, std::int64_t dynamicDimension, std::vector<std::vector<std::int64_t>>& shapes, std::vector<Ort::Value>& values, std::vector<Utils::span<float>>& data)
+{
+	for (const auto& info : infos)
+	{
+		auto tensor = Utils::AllocateTensor(Utils::ResolveShape(info, dynamicDimension));
+		shapes.push_back(std::move(tensor.Shape));
+		values.push_back(std::move(tensor.Value));
+		data.push_back(tensor.Data);
+	}
+}
+
+Utils::SteadyStateSession::SteadyStateSession(Model& model, std::int64_t dynamicDimension)
+	: model(model), binding(model.Session)
+{
+	AllocateTensors(model.Inputs, dynamicDimension, inputShapes, inputs, inputData);
+	AllocateTensors(model.Outputs, dynamicDimension, outputShapes, outputs, outputData);
+
+	for (size_t i = 0; i < inputs.size(); ++i)
+	{
+		binding.BindInput(model.InputNames[i], inputs[i]);
+	}
+	for (size_t i = 0; i < outputs.size(); ++i)
+	{
+		binding.BindOutput(model.OutputNames[i], outputs[i]);
+	}
+}
+
+Utils::span<float> Utils::SteadyStateSession::Input(size_t index)
+{
+	return inputData[index];
+}
+
+Utils::span<float> Utils::SteadyStateSession::Output(size_t index)
+{
+	return outputData[index];
+}
+
+const std::vector<std::int64_t>& Utils::SteadyStateSession::InputShape(size_t index) const
+{
+	return inputShapes[index];
+}
+
+const std::vector<std::int64_t>& Utils::SteadyStateSession::OutputShape(size_t index) const
+{
+	return outputShapes[index];
+}
+
+void Utils::SteadyStateSession::Run()
+{
+	model.Session.Run(runOptions, binding);
+}
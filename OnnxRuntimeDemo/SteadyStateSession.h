@@ -0,0 +1,38 @@
+#pragma once
+#include <onnxruntime_cxx_api.h>
+#include <vector>
+#include "span.h"
+
+namespace Utils
+{
+	class Model;
+
+	// input and output tensors are allocated once (from the shapes of the model) and bound with Ort::IoBinding:
+	// each frame overwrites Input() and reads Output() in place, no allocations happen on Run()
+	class SteadyStateSession
+	{
+	public:
+		// dynamic dimensions (e.g. the batch) are replaced by dynamicDimension, only float tensors are supported
+		explicit SteadyStateSession(Model& model, std::int64_t dynamicDimension = 1);
+		SteadyStateSession(const SteadyStateSession&) = delete;
+		SteadyStateSession& operator=(const SteadyStateSession&) = delete;
+
+		span<float> Input(size_t index = 0);
+		span<float> Output(size_t index = 0);
+		const std::vector<std::int64_t>& InputShape(size_t index = 0) const;
+		const std::vector<std::int64_t>& OutputShape(size_t index = 0) const;
+
+		void Run();
+
+	private:
+		Model& model;
+		std::vector<std::vector<std::int64_t>> inputShapes;
+		std::vector<std::vector<std::int64_t>> outputShapes;
+		std::vector<Ort::Value> inputs;
+		std::vector<Ort::Value> outputs;
+		std::vector<span<float>> inputData;
+		std::vector<span<float>> outputData;
+		Ort::IoBinding binding;
+		Ort::RunOptions runOptions;
+	};
+}
@@ -0,0 +1,36 @@
+#include "ThreadBudget.h"
+#include <opencv2/core/utility.hpp>
+#include <algorithm>
+
+Utils::ThreadBudget Utils::ThreadBudget::Split(int cores, float intraOpShare, float openCvShare, bool allowSpinning)
+{
+	cores = std::max(cores, 1);
+	ThreadBudget budget;
+	budget.IntraOpThreads = std::max(1, static_cast<int>(cores * intraOpShare));
+	budget.InterOpThreads = 1;
+	budget.OpenCvThreads = std::max(1, static_cast<int>(cores * openCvShare));
+	budget.ImageWorkers = std::max(1, cores - budget.IntraOpThreads - budget.OpenCvThreads);
+	budget.AllowSpinning = allowSpinning;
+	return budget;
+}
+
+void Utils::ThreadBudget::ApplyToOpenCv() const
+{
+	cv::setNumThreads(OpenCvThreads);
+}
+
+static Utils::ThreadBudget& CurrentBudget()
+{
+	static Utils::ThreadBudget budget = Utils::ThreadBudget::Split();
+	return budget;
+}
+
+const Utils::ThreadBudget& Utils::ThreadBudget::Current()
+{
+	return CurrentBudget();
+}
+
+void Utils::ThreadBudget::MakeCurrent() const
+{
+	CurrentBudget() = *this;
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include <thread>
+
+namespace Utils
+{
+	// how the cores of the machine are split between the libraries which spin up their own threads
+	struct ThreadBudget
+	{
+		int IntraOpThreads = 1;
+		int InterOpThreads = 1;
+		int OpenCvThreads = 1;
+		int ImageWorkers = 1;
+		// spinning threads react faster but burn cores that other pools could use
+		// only applies to the global pools of EnvMode::GlobalThreadPools: ORT 1.4 has no spin option per session
+		bool AllowSpinning = false;
+
+		// intra-op and OpenCV get their share of the cores, our image workers get the rest
+		// (inter-op threads are used only by sessions in ORT_PARALLEL mode, so one is enough by default)
+		static ThreadBudget Split(int cores = static_cast<int>(std::thread::hardware_concurrency()), float intraOpShare = 0.5f, float openCvShare = 0.25f, bool allowSpinning = false);
+
+		// cv::resize, convertTo, imread, etc will not use more than OpenCvThreads
+		void ApplyToOpenCv() const;
+
+		// the budget the image pools and pipelines size themselves from: Split() until ModelRegistry::Configure
+		// makes its budget the current one (call it before starting any worker)
+		static const ThreadBudget& Current();
+		void MakeCurrent() const;
+	};
+}
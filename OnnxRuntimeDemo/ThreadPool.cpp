@@ -0,0 +1,249 @@
+#include "ThreadPool.h"
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+static thread_local const Utils::ThreadPool* currentPool = nullptr;
+static thread_local size_t currentWorker = 0;
+
+Utils::ThreadPool::ThreadPool(size_t workers, size_t maxInFlight)
+	: maxInFlight(maxInFlight ? maxInFlight : 2 * std::max<size_t>(workers, 1))
+{
+	workers = std::max<size_t>(workers, 1);
+	for (size_t i = 0; i < workers; ++i)
+	{
+		queues.push_back(std::make_unique<WorkQueue>());
+	}
+	for (size_t i = 0; i < workers; ++i)
+	{
+		threads.emplace_back([this, i] { WorkerLoop(i); });
+	}
+}
+
+Utils::ThreadPool::~ThreadPool()
+{
+	{
+		std::unique_lock lock{ stateMutex };
+		allDone.wait(lock, [this] { return inFlight == 0; });
+		stopping = true;
+	}
+	workAvailable.notify_all();
+	for (auto& t : threads)
+	{
+		t.join();
+	}
+}
+
+void Utils::ThreadPool::Submit(std::function<void()> task)
+{
+	const auto fromWorker = currentPool == this;
+	{
+		std::unique_lock lock{ stateMutex };
+		if (!fromWorker)
+		{
+			slotAvailable.wait(lock, [this] { return inFlight < maxInFlight || cancelled; });
+		}
+		if (cancelled)
+			return;
+
+		auto& queue = *queues[fromWorker ? currentWorker : nextQueue++ % queues.size()];
+		{
+			std::lock_guard queueLock{ queue.mutex };
+			queue.tasks.push_back(std::move(task));
+		}
+		++inFlight;
+		++queued;
+	}
+	workAvailable.notify_one();
+}
+
+void Utils::ThreadPool::Wait()
+{
+	std::unique_lock lock{ stateMutex };
+	allDone.wait(lock, [this] { return inFlight == 0; });
+	cancelled = false;
+	if (firstError)
+	{
+		std::rethrow_exception(std::exchange(firstError, nullptr));
+	}
+}
+
+void Utils::ThreadPool::Cancel()
+{
+	std::lock_guard lock{ stateMutex };
+	cancelled = true;
+	size_t discarded = 0;
+	for (auto& queue : queues)
+	{
+		std::lock_guard queueLock{ queue->mutex };
+		discarded += queue->tasks.size();
+		queue->tasks.clear();
+	}
+
+	queued -= discarded;
+	inFlight -= discarded;
+	slotAvailable.notify_all();
+	if (inFlight == 0)
+		allDone.notify_all();
+}
+
+bool Utils::ThreadPool::Cancelled() const
+{
+	return cancelled;
+}
+
+size_t Utils::ThreadPool::WorkerCount() const
+{
+	return threads.size();
+}
+
+void Utils::ThreadPool::WorkerLoop(size_t index)
+{
+	currentPool = this;
+	currentWorker = index;
+	std::function<void()> task;
+	while (true)
+	{
+		if (TryPop(index, task))
+		{
+			Execute(task);
+			continue;
+		}
+
+		std::unique_lock lock{ stateMutex };
+		workAvailable.wait(lock, [this] { return stopping || queued > 0; });
+		if (stopping && queued == 0)
+			return;
+	}
+}
+
+bool Utils::ThreadPool::TryPop(size_t index, std::function<void()>& task)
+{
+	// newest task of our own queue first (it's likely hot in cache), then the oldest of the others
+	for (size_t i = 0; i < queues.size(); ++i)
+	{
+		auto& queue = *queues[(index + i) % queues.size()];
+		std::lock_guard lock{ queue.mutex };
+		if (!queue.tasks.empty())
+		{
+			if (i == 0)
+			{
+				task = std::move(queue.tasks.back());
+				queue.tasks.pop_back();
+			}
+			else
+			{
+				task = std::move(queue.tasks.front());
+				queue.tasks.pop_front();
+			}
+			--queued;
+			return true;
+		}
+	}
+	return false;
+}
+
+void Utils::ThreadPool::Execute(std::function<void()>& task)
+{
+	try
+	{
+		task();
+	}
+	catch (...)
+	{
+		{
+			std::lock_guard lock{ stateMutex };
+			if (!firstError)
+				firstError = std::current_exception();
+		}
+		Cancel();
+	}
+	task = nullptr;
+
+	std::lock_guard lock{ stateMutex };
+	--inFlight;
+	slotAvailable.notify_one();
+	if (inFlight == 0)
+		allDone.notify_all();
+}
+
+// shared by the copies of a task: the last one is destroyed after the task ran, or unrun when the pool discarded it
+struct Utils::TaskGroup::TaskState
+{
+	TaskGroup* Group;
+	bool Ran = false;
+	std::exception_ptr Error;
+
+	~TaskState()
+	{
+		Group->Finish(Ran ? Error : std::make_exception_ptr(std::runtime_error("TaskGroup: the task was discarded by a cancelled pool")));
+	}
+};
+
+Utils::TaskGroup::TaskGroup(ThreadPool& pool)
+	: pool(pool)
+{
+}
+
+Utils::TaskGroup::~TaskGroup()
+{
+	std::unique_lock lock{ mutex };
+	allDone.wait(lock, [this] { return pending == 0; });
+}
+
+void Utils::TaskGroup::Submit(std::function<void()> task)
+{
+	{
+		std::lock_guard lock{ mutex };
+		++pending;
+	}
+	// the exceptions stay in the group: they neither cancel the pool nor reach the other callers of its Wait
+	auto state = std::make_shared<TaskState>();
+	state->Group = this;
+	pool.Submit([state = std::move(state), task = std::move(task)] {
+		try
+		{
+			if (!state->Group->Cancelled())
+				task();
+		}
+		catch (...)
+		{
+			state->Error = std::current_exception();
+		}
+		state->Ran = true;
+	});
+}
+
+void Utils::TaskGroup::Wait()
+{
+	std::unique_lock lock{ mutex };
+	allDone.wait(lock, [this] { return pending == 0; });
+	cancelled = false;
+	if (firstError)
+	{
+		std::rethrow_exception(std::exchange(firstError, nullptr));
+	}
+}
+
+void Utils::TaskGroup::Cancel()
+{
+	cancelled = true;
+}
+
+bool Utils::TaskGroup::Cancelled() const
+{
+	return cancelled;
+}
+
+void Utils::TaskGroup::Finish(std::exception_ptr error)
+{
+	// under the lock: the group may be destroyed as soon as Wait sees pending at 0
+	std::lock_guard lock{ mutex };
+	if (error && !firstError)
+	{
+		firstError = error;
+		cancelled = true;
+	}
+	if (--pending == 0)
+		allDone.notify_all();
+}
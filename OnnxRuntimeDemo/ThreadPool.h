@@ -0,0 +1,95 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "ThreadBudget.h"
+
+namespace Utils
+{
+	// fixed set of workers, each one with its own queue: idle workers steal from the others
+	// at most maxInFlight tasks are queued or running at the same time, Submit blocks when the limit is reached
+	// the first exception thrown by a task cancels the pending tasks and is rethrown by Wait
+	class ThreadPool
+	{
+	public:
+		// by default the image workers of the current ThreadBudget, maxInFlight = 0 means twice the number of workers
+		explicit ThreadPool(size_t workers = ThreadBudget::Current().ImageWorkers, size_t maxInFlight = 0);
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+		~ThreadPool();
+
+		// tasks submitted from a worker of this pool never block (it would deadlock) and go to the worker's own queue
+		void Submit(std::function<void()> task);
+		// blocks until all the submitted tasks are done, then rethrows the first exception thrown by a task (if any)
+		void Wait();
+		// discards the pending tasks (running ones complete) and ignores the next submissions until Wait returns
+		void Cancel();
+		bool Cancelled() const;
+		size_t WorkerCount() const;
+
+	private:
+		struct WorkQueue
+		{
+			std::mutex mutex;
+			std::deque<std::function<void()>> tasks;
+		};
+
+		void WorkerLoop(size_t index);
+		bool TryPop(size_t index, std::function<void()>& task);
+		void Execute(std::function<void()>& task);
+
+		std::vector<std::unique_ptr<WorkQueue>> queues;
+		size_t maxInFlight;
+		std::atomic<size_t> nextQueue{ 0 };
+		std::atomic<size_t> queued{ 0 };
+		std::atomic<bool> cancelled{ false };
+
+		std::mutex stateMutex;
+		std::condition_variable workAvailable;
+		std::condition_variable slotAvailable;
+		std::condition_variable allDone;
+		size_t inFlight = 0;
+		bool stopping = false;
+		std::exception_ptr firstError;
+		
+		std::vector<std::thread> threads;
+	};
+
+	// the tasks of one caller on a shared pool: Wait waits only for them and rethrows only their first exception,
+	// the other tasks of the pool and its Wait are left alone. Must not wait from a worker of the pool
+	class TaskGroup
+	{
+	public:
+		explicit TaskGroup(ThreadPool& pool);
+		TaskGroup(const TaskGroup&) = delete;
+		TaskGroup& operator=(const TaskGroup&) = delete;
+		// waits for the tasks, their exceptions are lost
+		~TaskGroup();
+
+		void Submit(std::function<void()> task);
+		// blocks until the submitted tasks are done, then rethrows the first exception thrown by one of them
+		// (a task discarded by a cancelled pool counts as failed)
+		void Wait();
+		// the tasks of the group that have not started yet are skipped, until Wait returns
+		// the first exception thrown by a task of the group cancels it the same way
+		void Cancel();
+		bool Cancelled() const;
+
+	private:
+		struct TaskState;
+		void Finish(std::exception_ptr error);
+
+		ThreadPool& pool;
+		std::mutex mutex;
+		std::condition_variable allDone;
+		size_t pending = 0;
+		std::exception_ptr firstError;
+		std::atomic<bool> cancelled{ false };
+	};
+}
@@ -0,0 +1,141 @@
+#include "Tracing.h"
+#include "Json.h"
+#include <fstream>
+#include <iomanip>
+#include <stdexcept>
+
+Utils::Tracer& Utils::Tracer::Instance()
+{
+	static Tracer tracer;
+	return tracer;
+}
+
+void Utils::Tracer::Start()
+{
+	std::lock_guard lock{ mutex };
+	for (auto& spans : threads)
+		spans->clear();
+	startTime = std::chrono::steady_clock::now();
+	startTicks = ReadTicks();
+	enabled.store(true, std::memory_order_relaxed);
+}
+
+// returns the track of the thread to the tracer when the thread exits
+struct Utils::Tracer::ThreadExit
+{
+	std::vector<Span>& Spans;
+
+	~ThreadExit()
+	{
+		Tracer::Instance().Release(Spans);
+	}
+};
+
+std::vector<Utils::Tracer::Span>& Utils::Tracer::Acquire()
+{
+	std::lock_guard lock{ mutex };
+	if (!released.empty())
+	{
+		auto& spans = *released.back();
+		released.pop_back();
+		return spans;
+	}
+	threads.push_back(std::make_unique<std::vector<Span>>());
+	return *threads.back();
+}
+
+void Utils::Tracer::Release(std::vector<Span>& spans)
+{
+	std::lock_guard lock{ mutex };
+	released.push_back(&spans);
+}
+
+void Utils::Tracer::Record(Stage stage, std::uint64_t startTicks, std::uint64_t endTicks)
+{
+	thread_local std::vector<Span>* spans = nullptr;
+	if (!spans)
+	{
+		spans = &Acquire();
+		thread_local const ThreadExit exit{ *spans };
+	}
+	spans->push_back({ stage, startTicks, endTicks });
+}
+
+// complete event ("X"), ts and dur in microseconds
+static void WriteSpan(std::ostream& os, const char* name, const char* category, double ts, double dur, int pid, int tid)
+{
+	os << "{\"name\":";
+	Utils::WriteJsonString(os, name);
+	os << ",\"cat\":\"" << category << "\",\"ph\":\"X\",\"ts\":" << ts << ",\"dur\":" << dur << ",\"pid\":" << pid << ",\"tid\":" << tid << "}";
+}
+
+// names a process ("process_name") or a thread ("thread_name") of the timeline
+static void WriteName(std::ostream& os, const char* what, const std::string& name, int pid, int tid)
+{
+	os << "{\"name\":\"" << what << "\",\"ph\":\"M\",\"pid\":" << pid << ",\"tid\":" << tid << ",\"args\":{\"name\":";
+	Utils::WriteJsonString(os, name);
+	os << "}}";
+}
+
+void Utils::Tracer::Write(const std::filesystem::path& path, const std::vector<OrtProfile>& ortProfiles)
+{
+	enabled.store(false, std::memory_order_relaxed);
+	std::lock_guard lock{ mutex };
+	const auto microsecondsPerTick = MicrosecondsPerTick(startTicks, startTime);
+
+	std::ofstream file(path);
+	if (!file)
+	{
+		throw std::runtime_error("cannot write " + path.string());
+	}
+	file << std::fixed << std::setprecision(3) << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	auto separator = [&, first = true]() mutable {
+		if (!first)
+			file << ",\n";
+		first = false;
+	};
+
+	// the stages of the application: process 1, one track per thread
+	constexpr auto appPid = 1;
+	separator();
+	WriteName(file, "process_name", "app", appPid, 0);
+	for (size_t thread = 0; thread < threads.size(); ++thread)
+	{
+		const auto tid = static_cast<int>(thread + 1);
+		separator();
+		WriteName(file, "thread_name", "thread " + std::to_string(tid), appPid, tid);
+		for (const auto& span : *threads[thread])
+		{
+			separator();
+			const auto ts = (static_cast<double>(span.Start) - static_cast<double>(startTicks)) * microsecondsPerTick;
+			WriteSpan(file, ToString(span.Name), "stage", ts, (span.End - span.Start) * microsecondsPerTick, appPid, tid);
+		}
+	}
+
+	// the events of each session, shifted by the time between the start of the trace and the creation of the session
+	auto pid = appPid;
+	for (const auto& profile : ortProfiles)
+	{
+		const auto profileDocument = ReadJsonFile(profile.Path);
+		// ORT writes a bare array of events, other tools wrap it in traceEvents
+		const auto* traceEvents = profileDocument.Find("traceEvents");
+		const auto& events = traceEvents ? traceEvents->Elements() : profileDocument.Elements();
+		const auto offset = std::chrono::duration<double, std::micro>(profile.Start - startTime).count();
+
+		++pid;
+		separator();
+		WriteName(file, "process_name", "onnxruntime " + profile.Path.filename().string(), pid, 0);
+		for (auto event : events)
+		{
+			auto* ts = event.Find("ts");
+			if (!ts)
+				continue;
+			ts->Value = ts->Number() + offset;
+			if (auto* eventPid = event.Find("pid"))
+				eventPid->Value = static_cast<double>(pid);
+			separator();
+			WriteJson(file, event);
+		}
+	}
+	file << "\n]}\n";
+}
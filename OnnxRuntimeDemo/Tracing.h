@@ -0,0 +1,68 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "Instrumentation.h"
+
+namespace Utils
+{
+	// profile written by ORT for one session: its timestamps count from the creation of the session
+	struct OrtProfile
+	{
+		std::filesystem::path Path;
+		std::chrono::steady_clock::time_point Start;
+	};
+
+	// timeline of the stage timers in the Chrome trace-event format (chrome://tracing, ui.perfetto.dev), one track per thread
+	class Tracer
+	{
+	public:
+		static Tracer& Instance();
+
+		// checked by every stage timer
+		static bool Enabled()
+		{
+			return enabled.load(std::memory_order_relaxed);
+		}
+
+		// from now on the stage timers record spans and the sessions created by the ModelRegistry profile their operators.
+		// ORT decides when the session is created: the models the registry loaded before Start (or profiled by a previous
+		// trace, until EndProfiling) are not in the timeline, ModelRegistry::Get reports them
+		void Start();
+		// ticks are two ReadTicks of the calling thread
+		void Record(Stage stage, std::uint64_t startTicks, std::uint64_t endTicks);
+		// stops tracing, then writes the spans and the operators of each profile on the same clock (ORT measures with
+		// high_resolution_clock, the steady_clock of MSVC). Must not be called while stages are running
+		void Write(const std::filesystem::path& path, const std::vector<OrtProfile>& ortProfiles = {});
+
+	private:
+		Tracer() = default;
+
+		struct Span
+		{
+			Stage Name;
+			std::uint64_t Start;
+			std::uint64_t End;
+		};
+
+		struct ThreadExit;
+
+		std::vector<Span>& Acquire();
+		void Release(std::vector<Span>& spans);
+
+		inline static std::atomic<bool> enabled{ false };
+
+		std::mutex mutex;
+		// one per thread in the order they recorded their first span, which gives the id of their track. A thread that
+		// exits hands its track, spans included, to the next thread that records: there are never more tracks than threads
+		// recording at the same time, and the spans of a track never overlap
+		std::vector<std::unique_ptr<std::vector<Span>>> threads;
+		std::vector<std::vector<Span>*> released;
+		std::chrono::steady_clock::time_point startTime;
+		std::uint64_t startTicks = 0;
+	};
+}
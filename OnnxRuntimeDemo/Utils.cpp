@@ -1,24 +1,44 @@
 #include "Utils.h"
 #include <fstream>
 #include <onnxruntime_cxx_api.h>
+#include "Instrumentation.h"
 
 cv::Mat Utils::ResizeToFloat(const cv::Mat& frame, const cv::Size& size, float alpha, float beta, cv::InterpolationFlags interpolation)
 {
 	cv::Mat dst;
-	cv::resize(frame, dst, size, 0.0f, 0.0f, interpolation);
-	dst.convertTo(dst, CV_32FC3, alpha, beta);
+	ResizeToFloat(frame, dst, size, alpha, beta, interpolation);
 	return dst;
 }
 
 cv::Mat Utils::RemoveMeanDivideByStd(const cv::Mat& frame, cv::Size size)
 {
 	cv::Mat dst;
-	resize(frame, dst, size);
-	dst.convertTo(dst, CV_32FC3, 1.0f, -127.0f);
-	dst.convertTo(dst, CV_32FC3, 1.0f / 128.0f, 0.0f);
+	RemoveMeanDivideByStd(frame, dst, size);
 	return dst;
 }
 
+void Utils::ResizeToFloat(const cv::Mat& frame, cv::Mat& dst, const cv::Size& size, float alpha, float beta, cv::InterpolationFlags interpolation)
+{
+	// resize into a thread-local 8-bit buffer, then convert into dst (both reuse their memory across calls)
+	thread_local cv::Mat resized;
+	cv::resize(frame, resized, size, 0.0f, 0.0f, interpolation);
+	resized.convertTo(dst, CV_32FC3, alpha, beta);
+}
+
+void Utils::RemoveMeanDivideByStd(const cv::Mat& frame, cv::Mat& dst, cv::Size size)
+{
+	thread_local cv::Mat resized;
+	resize(frame, resized, size);
+	resized.convertTo(dst, CV_32FC3, 1.0f, -127.0f);
+	dst.convertTo(dst, CV_32FC3, 1.0f / 128.0f, 0.0f);
+}
+
+cv::Mat Utils::ReadImage(const std::filesystem::path& path)
+{
+	ScopeTimer timer{ Stage::Decode };
+	return cv::imread(path.string(), cv::IMREAD_COLOR);
+}
+
 std::vector<std::string> Utils::ReadClasses(const char* fileName)
 {
 	std::ifstream file(fileName);
@@ -80,6 +100,13 @@ std::string Utils::OnnxGetOutputName(Ort::Session& session, size_t index)
 	return OnnxGetString(&Ort::Session::GetOutputName, session, index);
 }
 
+std::string Utils::OnnxEndProfiling(Ort::Session& session)
+{
+	Ort::AllocatorWithDefaultOptions allocator;
+	const OrtStringOwner owner{ session.EndProfiling(allocator), OrtDeleter{ *allocator } };
+	return owner.get();
+}
+
 template<typename Getter, typename CountGetter>
 std::vector<std::string> OnnxGetNames(Getter getter, CountGetter countGetter, Ort::Session& session)
 {
@@ -112,9 +139,14 @@ std::vector<const char*> Utils::MakeConstCharPtrVector(span<std::string> strings
 	return out;
 }
 
+std::vector<std::int64_t> Utils::GetInputShape(Ort::Session& session, size_t index)
+{
+	return session.GetInputTypeInfo(index).GetTensorTypeAndShapeInfo().GetShape();
+}
+
 std::vector<std::int64_t> Utils::GetOutputShape(Ort::Session& session, size_t index)
 {
-	return session.GetOutputTypeInfo(0).GetTensorTypeAndShapeInfo().GetShape();
+	return session.GetOutputTypeInfo(index).GetTensorTypeAndShapeInfo().GetShape();
 }
 
 Utils::span<float> Utils::AsSpan(Ort::Value& tensor)
@@ -6,6 +6,7 @@
 #include <algorithm>
 #include <thread>
 #include "span.h"
+#include "ThreadPool.h"
 
 namespace Ort
 {
@@ -17,7 +18,13 @@ namespace Utils
 {
 	cv::Mat ResizeToFloat(const cv::Mat& frame, const cv::Size& size, float alpha = 1.0f / 255.0f, float beta = 0.0f, cv::InterpolationFlags interpolation = cv::InterpolationFlags::INTER_LINEAR);
 	cv::Mat RemoveMeanDivideByStd(const cv::Mat& frame, cv::Size size);
+	// same as above but reuse the memory of dst when it already has the right size
+	void ResizeToFloat(const cv::Mat& frame, cv::Mat& dst, const cv::Size& size, float alpha = 1.0f / 255.0f, float beta = 0.0f, cv::InterpolationFlags interpolation = cv::InterpolationFlags::INTER_LINEAR);
+	void RemoveMeanDivideByStd(const cv::Mat& frame, cv::Mat& dst, cv::Size size);
 	
+	// cv::imread in color, timed as the decode stage
+	cv::Mat ReadImage(const std::filesystem::path& path);
+
 	std::vector<std::string> ReadClasses(const char* fileName);
 	const std::vector<std::string>& GetCoco2017Classes();
 	
@@ -28,7 +35,7 @@ namespace Utils
 		{
 			if (p.is_regular_file() && p.path().extension() == extension)
 			{
-				auto image = cv::imread(p.path().string(), cv::IMREAD_COLOR);
+				auto image = ReadImage(p.path());
 				action(image, p.path());
 			}
 		}
@@ -43,7 +50,7 @@ namespace Utils
 				break;
 			if (p.is_regular_file() && p.path().extension() == extension)
 			{
-				auto image = cv::imread(p.path().string(), cv::IMREAD_COLOR);
+				auto image = ReadImage(p.path());
 				action(image, p.path());
 			}
 		}
@@ -62,22 +69,44 @@ namespace Utils
 		}
 	};
 	
+	// images are decoded and processed by the workers of the pool, each task with its own copy of action:
+	// no more than the in-flight limit of the pool are in memory at the same time, whatever the size of the folder.
+	// Waits only for its own tasks, the pool may be shared. The first exception thrown by an action skips the images
+	// not started yet, stops the enumeration and is rethrown
 	template<typename Action>
-	void ParallelForEachImage(const char* extension, const char* imgPath, Action action)
+	void ParallelForEachImage(const char* extension, const char* imgPath, ThreadPool& pool, Action action)
 	{
-		std::vector<std::thread> threads;
-		defer_join_all guard{ threads };
-		
-		for (auto& p : std::filesystem::directory_iterator(imgPath))
+		TaskGroup tasks{ pool };
+		try
 		{
-			if (p.is_regular_file() && p.path().extension() == extension)
+			for (auto& p : std::filesystem::directory_iterator(imgPath))
 			{
-				threads.emplace_back([thisPath = p.path(), action] {
-					auto image = cv::imread(thisPath.string(), cv::IMREAD_COLOR);
-					action(image, thisPath);
-				});
+				if (tasks.Cancelled())
+					break;
+				if (p.is_regular_file() && p.path().extension() == extension)
+				{
+					tasks.Submit([thisPath = p.path(), action]() mutable {
+						auto image = ReadImage(thisPath);
+						action(image, thisPath);
+					});
+				}
 			}
 		}
+		catch (...)
+		{
+			// the destructor of the group waits for the tasks already started
+			tasks.Cancel();
+			throw;
+		}
+		tasks.Wait();
+	}
+
+	// same as above on a pool of its own, sized by the image workers of the current ThreadBudget
+	template<typename Action>
+	void ParallelForEachImage(const char* extension, const char* imgPath, Action action)
+	{
+		ThreadPool pool;
+		ParallelForEachImage(extension, imgPath, pool, std::move(action));
 	}
 
 	template<typename T>
@@ -109,7 +138,10 @@ namespace Utils
 	std::string OnnxGetOutputName(Ort::Session& session, size_t index);
 	std::vector<std::string> OnnxGetInputNames(Ort::Session& session);
 	std::vector<std::string> OnnxGetOutputNames(Ort::Session& session);
+	// name of the profile file the session has written
+	std::string OnnxEndProfiling(Ort::Session& session);
 	std::vector<const char*> MakeConstCharPtrVector(span<std::string> strings);
+	std::vector<std::int64_t> GetInputShape(Ort::Session& session, size_t index);
 	std::vector<std::int64_t> GetOutputShape(Ort::Session& session, size_t index);
 	
 	span<float> AsSpan(Ort::Value& tensor);
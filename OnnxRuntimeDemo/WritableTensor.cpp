@@ -0,0 +1,74 @@
+#include "WritableTensor.h"
+#include "ModelRegistry.h"
+#include "Utils.h"
+#include <functional>
+#include <new>
+
+static const std::align_val_t ArenaAlignment{ 64 };
+
+static size_t ElementCount(const std::vector<std::int64_t>& shape)
+{
+	return std::accumulate(begin(shape), end(shape), size_t{ 1 }, std::multiplies<>{});
+}
+
+std::vector<std::int64_t> Utils::ResolveShape(const TensorInfo& info, std::int64_t dynamicDimension)
+{
+	if (info.ElementType != ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT)
+	{
+		throw std::invalid_argument("only float tensors are supported (" + info.Name + ")");
+	}
+	auto shape = info.Shape;
+	std::replace_if(begin(shape), end(shape), [](auto dim) { return dim < 0; }, dynamicDimension);
+	return shape;
+}
+
+Utils::WritableTensor Utils::AllocateTensor(std::vector<std::int64_t> shape)
+{
+	Ort::AllocatorWithDefaultOptions allocator;
+	WritableTensor tensor;
+	tensor.Value = Ort::Value::CreateTensor<float>(allocator, shape.data(), shape.size());
+	tensor.Data = AsSpan(tensor.Value);
+	tensor.Shape = std::move(shape);
+	return tensor;
+}
+
+Utils::WritableTensor Utils::AllocateInput(const Model& model, size_t index, std::int64_t dynamicDimension)
+{
+	return AllocateTensor(ResolveShape(model.Inputs[index], dynamicDimension));
+}
+
+Utils::WritableTensor Utils::WrapTensor(span<float> memory, std::vector<std::int64_t> shape)
+{
+	const auto count = ElementCount(shape);
+	if (memory.size() < count)
+	{
+		throw std::invalid_argument("memory is smaller than the shape of the tensor");
+	}
+	static const auto memoryInfo = Ort::MemoryInfo::CreateCpu(OrtDeviceAllocator, OrtMemTypeCPU);
+	WritableTensor tensor;
+	tensor.Value = Ort::Value::CreateTensor<float>(memoryInfo, memory.data(), count, shape.data(), shape.size());
+	tensor.Data = memory.first(count);
+	tensor.Shape = std::move(shape);
+	return tensor;
+}
+
+void Utils::TensorArena::AlignedDelete::operator()(float* memory) const
+{
+	::operator delete[](memory, ArenaAlignment);
+}
+
+Utils::WritableTensor Utils::TensorArena::Tensor(std::vector<std::int64_t> shape)
+{
+	const auto count = ElementCount(shape);
+	if (count > capacity)
+	{
+		memory.reset(static_cast<float*>(::operator new[](count * sizeof(float), ArenaAlignment)));
+		capacity = count;
+	}
+	return WrapTensor({ memory.get(), capacity }, std::move(shape));
+}
+
+size_t Utils::TensorArena::Capacity() const
+{
+	return capacity;
+}
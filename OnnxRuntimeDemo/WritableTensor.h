@@ -0,0 +1,47 @@
+#pragma once
+#include <onnxruntime_cxx_api.h>
+#include <memory>
+#include <vector>
+#include "span.h"
+
+namespace Utils
+{
+	struct TensorInfo;
+	class Model;
+
+	// a float tensor whose memory is filled in place (e.g. by the preprocessing) before being passed to Session::Run
+	struct WritableTensor
+	{
+		Ort::Value Value{ nullptr };
+		std::vector<std::int64_t> Shape;
+		span<float> Data;
+	};
+
+	// the shape of the tensor with its dynamic dimensions (e.g. the batch) replaced by dynamicDimension, only float tensors are supported
+	std::vector<std::int64_t> ResolveShape(const TensorInfo& info, std::int64_t dynamicDimension = 1);
+
+	// memory owned by the tensor, from the default CPU allocator of ORT
+	WritableTensor AllocateTensor(std::vector<std::int64_t> shape);
+	// same as above with the shape of an input of the model
+	WritableTensor AllocateInput(const Model& model, size_t index = 0, std::int64_t dynamicDimension = 1);
+	// memory owned by the caller, it must outlive the tensor
+	WritableTensor WrapTensor(span<float> memory, std::vector<std::int64_t> shape);
+
+	// 64-byte aligned memory reused by all the tensors made from it, it grows only when a bigger tensor is requested:
+	// tensors share the same memory, so only the last one returned by Tensor() can be used
+	class TensorArena
+	{
+	public:
+		WritableTensor Tensor(std::vector<std::int64_t> shape);
+		size_t Capacity() const;
+
+	private:
+		struct AlignedDelete
+		{
+			void operator()(float* memory) const;
+		};
+
+		std::unique_ptr<float[], AlignedDelete> memory;
+		size_t capacity = 0;
+	};
+}
@@ -2,6 +2,7 @@
 #include "Linear.h"
 #include "ResNet.h"
 #include "MobileNet.h"
+#include "ModelRegistry.h"
 
 using namespace std;
 
@@ -9,9 +10,22 @@ int main()
 {
 	try
 	{
+		// share ORT thread pools among all the sessions and split the cores with OpenCV
+		//Utils::ModelRegistry::Configure(Utils::EnvMode::GlobalThreadPools, Utils::ThreadBudget::Split());
+
+		// timeline of the stages and of the operators of ORT, open it in chrome://tracing or ui.perfetto.dev
+		//Utils::Tracer::Instance().Start();
+
 		Demo::RunLinearRegression();
 		//Demo::RunResNet();
+		//Demo::RunResNetBatched();
+		//Demo::RunResNetMicroBatched();
+		//Demo::CompareResNetProfiles();
 		//Demo::RunMobileNet();
+		//Demo::RunMobileNetPipelined();
+		//Demo::CompareMobileNetNms();
+
+		//Utils::Tracer::Instance().Write("trace.json", Utils::ModelRegistry::Instance().EndProfiling());
 	}
 	catch (const exception& e)
 	{